@@ -0,0 +1,348 @@
+// Microbenchmarks for the agent hot path: sensor generation, queue handoff,
+// protobuf (de)serialization, columnar batches, payload compression,
+// capture timestamps and an end-to-end loopback gRPC stream.
+//
+//   ./build/omnistream_bench --benchmark_filter=Generate
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <grpcpp/grpcpp.h>
+#include <zlib.h>
+
+#include "capture_clock.hpp"
+#include "lidar_codec.hpp"
+#include "packet_pool.hpp"
+#include "sensor_generator.hpp"
+#include "spsc_ring_buffer.hpp"
+#include "telemetry.grpc.pb.h"
+#include "telemetry.pb.h"
+#include "telemetry_batch.hpp"
+#include "thread_safe_queue.hpp"
+
+using namespace omnistream;
+
+// --- SensorGenerator -------------------------------------------------------
+
+static void BM_Generate(benchmark::State &state) {
+  PacketPool pool;
+  SensorGenerator sensor("AV-001", state.range(0), &pool);
+  for (auto _ : state) {
+    auto packet = sensor.generate();
+    benchmark::DoNotOptimize(packet->lidar_scan().data());
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(state.iterations() * state.range(0) * sizeof(float));
+}
+BENCHMARK(BM_Generate)->Arg(1024)->Arg(4096)->Arg(16384)->Arg(65536)->Arg(131072);
+
+// The compile-time generators, against BM_Generate at the same sizes.
+template <size_t N> static void BM_GenerateFixed(benchmark::State &state) {
+  PacketPool pool;
+  FixedSensorGenerator<N> sensor("AV-001", N, &pool);
+  for (auto _ : state) {
+    auto packet = sensor.generate();
+    benchmark::DoNotOptimize(packet->lidar_scan().data());
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(state.iterations() * N * sizeof(float));
+}
+BENCHMARK_TEMPLATE(BM_GenerateFixed, 1024);
+BENCHMARK_TEMPLATE(BM_GenerateFixed, 4096);
+
+static void BM_GenerateDelta16(benchmark::State &state) {
+  PacketPool pool;
+  SensorGenerator sensor("AV-001", state.range(0), &pool);
+  sensor.set_lidar_encoder(LidarDeltaEncoder());
+  for (auto _ : state) {
+    auto packet = sensor.generate();
+    benchmark::DoNotOptimize(packet->lidar_quantized().data());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_GenerateDelta16)->Arg(1024)->Arg(131072);
+
+// --- Capture clock ---------------------------------------------------------
+
+// Arg: 0 = steady_clock, 1 = TSC (falls back to steady_clock if not
+// invariant; the label says which ran).
+static void BM_CaptureClock(benchmark::State &state) {
+  CaptureClock::use(state.range(0) ? ClockSource::Tsc : ClockSource::Steady);
+  CaptureClock &clock = CaptureClock::local();
+  for (auto _ : state)
+    benchmark::DoNotOptimize(clock.now());
+  state.SetLabel(CaptureClock::source_name());
+  CaptureClock::use(ClockSource::Steady);
+}
+BENCHMARK(BM_CaptureClock)->Arg(0)->Arg(1);
+
+static void BM_SystemClock(benchmark::State &state) {
+  for (auto _ : state)
+    benchmark::DoNotOptimize(std::chrono::system_clock::now());
+}
+BENCHMARK(BM_SystemClock);
+
+// --- Queues ----------------------------------------------------------------
+
+// Producer/consumer pair: thread 0 pushes, thread 1 pops. Both run the same
+// iteration count, so every pushed item is consumed.
+template <typename Queue> static void BM_QueueHandoff(benchmark::State &state) {
+  static Queue *queue = nullptr;
+  if (state.thread_index() == 0)
+    queue = new Queue(1024);
+  // The framework starts timing only after every thread reaches the loop,
+  // but a barrier is still needed for the queue pointer to be visible.
+  static std::atomic<int> ready{0};
+  ready++;
+  while (ready.load() < state.threads())
+    std::this_thread::yield();
+
+  if (state.thread_index() == 0) {
+    uint64_t i = 0;
+    for (auto _ : state)
+      queue->push(i++);
+  } else {
+    for (auto _ : state)
+      benchmark::DoNotOptimize(queue->pop());
+  }
+  state.SetItemsProcessed(state.iterations());
+
+  if (--ready == 0) {
+    delete queue;
+    queue = nullptr;
+  }
+}
+BENCHMARK_TEMPLATE(BM_QueueHandoff, ThreadSafeQueue<uint64_t>)
+    ->Threads(2)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_QueueHandoff, SpscRingBuffer<uint64_t>)
+    ->Threads(2)
+    ->UseRealTime();
+
+// Uncontended push+pop on one thread: the per-operation floor.
+template <typename Queue> static void BM_QueuePushPop(benchmark::State &state) {
+  Queue queue(1024);
+  uint64_t i = 0;
+  for (auto _ : state) {
+    queue.push(i++);
+    benchmark::DoNotOptimize(queue.pop());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_QueuePushPop, ThreadSafeQueue<uint64_t>);
+BENCHMARK_TEMPLATE(BM_QueuePushPop, SpscRingBuffer<uint64_t>);
+
+// --- Serialization ---------------------------------------------------------
+
+static PacketPtr sample_packet(size_t points, bool delta) {
+  SensorGenerator sensor("AV-001", points);
+  if (delta)
+    sensor.set_lidar_encoder(LidarDeltaEncoder());
+  sensor.generate(); // Keyframe
+  return sensor.generate();
+}
+
+static void BM_Serialize(benchmark::State &state) {
+  auto packet = sample_packet(state.range(0), state.range(1));
+  std::string bytes;
+  for (auto _ : state) {
+    packet->SerializeToString(&bytes);
+    benchmark::DoNotOptimize(bytes.data());
+  }
+  state.SetBytesProcessed(state.iterations() * bytes.size());
+  state.counters["wire_bytes"] = bytes.size();
+}
+BENCHMARK(BM_Serialize)->ArgsProduct({{1024, 131072}, {0, 1}});
+
+static void BM_Parse(benchmark::State &state) {
+  auto packet = sample_packet(state.range(0), state.range(1));
+  std::string bytes = packet->SerializeAsString();
+  TelemetryPacket parsed;
+  for (auto _ : state) {
+    parsed.ParseFromString(bytes);
+    benchmark::DoNotOptimize(parsed.vehicle_id().data());
+  }
+  state.SetBytesProcessed(state.iterations() * bytes.size());
+  state.counters["wire_bytes"] = bytes.size();
+}
+BENCHMARK(BM_Parse)->ArgsProduct({{1024, 131072}, {0, 1}});
+
+// --- Columnar batches ------------------------------------------------------
+
+// 60 frames (one second of one vehicle) per batch; range(0) is the scan size.
+static std::vector<PacketPtr> sample_frames(size_t points) {
+  SensorGenerator sensor("AV-001", points);
+  std::vector<PacketPtr> frames;
+  for (int i = 0; i < 60; ++i)
+    frames.push_back(sensor.generate());
+  return frames;
+}
+
+static void BM_BatchAppend(benchmark::State &state) {
+  auto frames = sample_frames(state.range(0));
+  TelemetryBatch batch(frames.size(), state.range(0));
+  for (auto _ : state) {
+    batch.clear();
+    for (const auto &packet : frames)
+      batch.append(*packet);
+    benchmark::DoNotOptimize(batch.lidar_row(0));
+  }
+  state.SetItemsProcessed(state.iterations() * frames.size());
+}
+BENCHMARK(BM_BatchAppend)->Arg(1024)->Arg(16384);
+
+// Rebuilding packets from a batch of combined, IMU-only and LiDAR-only
+// frames. Every rebuilt packet must serialize exactly like its original;
+// the benchmark fails before timing anything otherwise.
+static void BM_BatchToPacket(benchmark::State &state) {
+  SensorGenerator sensor("AV-001", state.range(0));
+  std::vector<PacketPtr> frames;
+  for (int i = 0; i < 20; ++i) {
+    frames.push_back(sensor.generate());
+    frames.push_back(sensor.generate_imu());
+    frames.push_back(sensor.generate_lidar());
+  }
+  TelemetryBatch batch(frames.size(), state.range(0));
+  for (const auto &packet : frames)
+    batch.append(*packet);
+  TelemetryPacket rebuilt;
+  for (size_t i = 0; i < frames.size(); ++i) {
+    batch.to_packet(i, &rebuilt);
+    if (rebuilt.SerializeAsString() != frames[i]->SerializeAsString()) {
+      state.SkipWithError("to_packet() does not round-trip append()");
+      return;
+    }
+  }
+  for (auto _ : state) {
+    for (size_t i = 0; i < frames.size(); ++i) {
+      batch.to_packet(i, &rebuilt);
+      benchmark::DoNotOptimize(rebuilt.lidar_scan().data());
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * frames.size());
+}
+BENCHMARK(BM_BatchToPacket)->Arg(1024)->Arg(16384);
+
+// Nearest return per frame: walking the protobuf packets versus the batch's
+// aligned LiDAR block.
+static void BM_NearestRangePackets(benchmark::State &state) {
+  auto frames = sample_frames(state.range(0));
+  std::vector<float> out(frames.size());
+  for (auto _ : state) {
+    for (size_t i = 0; i < frames.size(); ++i) {
+      float nearest = INFINITY;
+      for (float d : frames[i]->lidar_scan())
+        nearest = d < nearest ? d : nearest;
+      out[i] = nearest;
+    }
+    benchmark::DoNotOptimize(out.data());
+  }
+  state.SetBytesProcessed(state.iterations() * frames.size() *
+                          state.range(0) * sizeof(float));
+}
+BENCHMARK(BM_NearestRangePackets)->Arg(1024)->Arg(16384);
+
+static void BM_NearestRangeBatch(benchmark::State &state) {
+  auto frames = sample_frames(state.range(0));
+  TelemetryBatch batch(frames.size(), state.range(0));
+  for (const auto &packet : frames)
+    batch.append(*packet);
+  std::vector<float> out(frames.size());
+  for (auto _ : state) {
+    batch.nearest_range(out.data());
+    benchmark::DoNotOptimize(out.data());
+  }
+  state.SetBytesProcessed(state.iterations() * frames.size() *
+                          state.range(0) * sizeof(float));
+}
+BENCHMARK(BM_NearestRangeBatch)->Arg(1024)->Arg(16384);
+
+// --- Compression -----------------------------------------------------------
+
+// zlib deflate of one serialized packet, which is what gRPC's gzip and
+// deflate stream compression run per message. Reports CPU per packet against
+// wire bytes so a codec can be picked per link. Args: points, delta16, level.
+static void BM_Compress(benchmark::State &state) {
+  auto packet = sample_packet(state.range(0), state.range(1));
+  const int level = static_cast<int>(state.range(2));
+  std::string raw = packet->SerializeAsString();
+  std::string out(compressBound(raw.size()), '\0');
+  uLongf size = 0;
+  for (auto _ : state) {
+    size = out.size();
+    compress2(reinterpret_cast<Bytef *>(out.data()), &size,
+              reinterpret_cast<const Bytef *>(raw.data()), raw.size(), level);
+    benchmark::DoNotOptimize(out.data());
+  }
+  state.SetBytesProcessed(state.iterations() * raw.size());
+  state.counters["raw_bytes"] = raw.size();
+  state.counters["wire_bytes"] = size;
+  state.counters["ratio"] = static_cast<double>(raw.size()) / size;
+}
+BENCHMARK(BM_Compress)->ArgsProduct({{1024, 131072}, {0, 1}, {1, 6}});
+
+// --- Loopback gRPC stream --------------------------------------------------
+
+// Sink server: reads every packet and acks none, so the sync client (which
+// never reads acks) is measured without back-pressure from unread responses.
+class SinkService final : public TelemetryStream::Service {
+public:
+  grpc::Status StreamTelemetry(
+      grpc::ServerContext *,
+      grpc::ServerReaderWriter<ServerAck, TelemetryPacket> *stream) override {
+    TelemetryPacket packet;
+    while (stream->Read(&packet))
+      received++;
+    return grpc::Status::OK;
+  }
+
+  std::atomic<uint64_t> received{0};
+};
+
+// Packets written per iteration over a localhost TCP stream; range(0) is the
+// batch size (1 = flush every write, N = buffer_hint on all but the last),
+// range(1) the stream compression (grpc_compression_algorithm).
+static void BM_LoopbackStream(benchmark::State &state) {
+  SinkService service;
+  int port = 0;
+  grpc::ServerBuilder builder;
+  builder.AddListeningPort("127.0.0.1:0", grpc::InsecureServerCredentials(),
+                           &port);
+  builder.RegisterService(&service);
+  auto server = builder.BuildAndStart();
+
+  auto channel = grpc::CreateChannel("127.0.0.1:" + std::to_string(port),
+                                     grpc::InsecureChannelCredentials());
+  auto stub = TelemetryStream::NewStub(channel);
+  grpc::ClientContext ctx;
+  ctx.set_compression_algorithm(
+      static_cast<grpc_compression_algorithm>(state.range(1)));
+  auto stream = stub->StreamTelemetry(&ctx);
+
+  const int64_t batch = state.range(0);
+  auto packet = sample_packet(1024, false);
+  const auto buffered = grpc::WriteOptions().set_buffer_hint();
+  int64_t n = 0;
+  for (auto _ : state) {
+    bool last = ++n % batch == 0;
+    stream->Write(*packet, last ? grpc::WriteOptions() : buffered);
+  }
+
+  stream->WritesDone();
+  stream->Finish();
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(state.iterations() * packet->ByteSizeLong());
+  server->Shutdown();
+}
+BENCHMARK(BM_LoopbackStream)
+    ->ArgsProduct({{1, 16}, {GRPC_COMPRESS_NONE, GRPC_COMPRESS_GZIP}})
+    ->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -1,143 +1,93 @@
 /**
  * OmniStream Dashboard
  * Real-time telemetry visualization for autonomous vehicle simulation.
+ *
+ * The connection and both plots live in render_worker.js, on a worker when
+ * the browser can hand it the canvases; this file only fills in the text
+ * panels from the summaries it posts.
  */
 
 const WS_URL = 'ws://localhost:8765';
-const VISUAL_UPDATE_MS = 66;  // ~15 FPS for smooth rendering
+// Asked of the C++ bridge: quantized binary frames at 20 Hz, cut down to
+// what the chart can show. Other servers ignore the request and keep sending
+// JSON. A fleet wall can narrow each tab with URL parameters, e.g.
+// ?vehicle=AV-001-0003&sector=300,60
+const LIDAR_BARS = 128;
+const SUBSCRIPTION = buildSubscription(new URLSearchParams(location.search));
+
+function buildSubscription(params) {
+    const sub = { type: 'subscribe', format: 'q16', rate: 20, max_points: LIDAR_BARS * 2 };
+    if (params.has('vehicle')) sub.vehicles = params.get('vehicle').split(',');
+    if (params.has('sector')) sub.sector = params.get('sector').split(',').map(Number);
+    if (params.has('rate')) sub.rate = Number(params.get('rate'));
+    return sub;
+}
 
-let ws = null;
-let packetsReceived = 0;
 let startTime = null;
-let lastPacketTime = null;
-let lastVisualUpdate = 0;
-let tickTimes = [];
-
-let lidarChart = null;
-let imuChart = null;
-
-const imuHistory = { labels: [], x: [], y: [], z: [] };
 
 function init() {
-    initCharts();
-    connectWebSocket();
+    startRenderer();
     startUptime();
 }
 
-function initCharts() {
-    lidarChart = new Chart(document.getElementById('lidarChart'), {
-        type: 'polarArea',
-        data: { labels: [], datasets: [{ data: [], backgroundColor: [], borderWidth: 1 }] },
-        options: {
-            responsive: true,
-            maintainAspectRatio: false,
-            animation: { duration: 0 },
-            plugins: { legend: { display: false } },
-            scales: { r: { beginAtZero: true, max: 15, ticks: { display: false } } }
-        }
+function startRenderer() {
+    const lidar = document.getElementById('lidarChart');
+    const imu = document.getElementById('imuChart');
+    const sizes = () => ({
+        lidar: [lidar.clientWidth, lidar.clientHeight],
+        imu: [imu.clientWidth, imu.clientHeight],
+        dpr: window.devicePixelRatio || 1
     });
-
-    imuChart = new Chart(document.getElementById('imuChart'), {
-        type: 'line',
-        data: {
-            labels: imuHistory.labels,
-            datasets: [
-                { label: 'X', data: imuHistory.x, borderColor: '#ff6b6b', fill: false, tension: 0.3, pointRadius: 0 },
-                { label: 'Y', data: imuHistory.y, borderColor: '#4ecdc4', fill: false, tension: 0.3, pointRadius: 0 },
-                { label: 'Z', data: imuHistory.z, borderColor: '#ffe66d', fill: false, tension: 0.3, pointRadius: 0 }
-            ]
-        },
-        options: {
-            responsive: true,
-            maintainAspectRatio: false,
-            animation: { duration: 0 },
-            scales: { x: { display: false } }
-        }
-    });
-}
-
-function connectWebSocket() {
-    setStatus('connecting');
-    ws = new WebSocket(WS_URL);
-
-    ws.onopen = () => {
-        setStatus('connected');
-        startTime = Date.now();
-    };
-
-    ws.onclose = () => {
-        setStatus('disconnected');
-        setTimeout(connectWebSocket, 2000);
-    };
-
-    ws.onerror = () => setStatus('error');
-
-    ws.onmessage = (e) => {
-        const msg = JSON.parse(e.data);
-        if (msg.type === 'telemetry') handleTelemetry(msg.data);
-    };
-}
-
-function handleTelemetry(data) {
-    const now = Date.now();
-
-    if (lastPacketTime) {
-        tickTimes.push(now - lastPacketTime);
-        if (tickTimes.length > 60) tickTimes.shift();
+    let resize = null;
+
+    try {
+        if (!window.Worker || !('transferControlToOffscreen' in lidar)) throw null;
+        const worker = new Worker('render_worker.js');
+        const offLidar = lidar.transferControlToOffscreen();
+        const offImu = imu.transferControlToOffscreen();
+        worker.onmessage = (e) => handleRendererMessage(e.data);
+        worker.postMessage({
+            type: 'start', url: WS_URL, subscription: SUBSCRIPTION,
+            lidar: offLidar, imu: offImu, sizes: sizes()
+        }, [offLidar, offImu]);
+        resize = (s) => worker.postMessage({ type: 'resize', sizes: s });
+    } catch {
+        // No OffscreenCanvas (or workers are blocked, e.g. on file://): run
+        // the same renderer on this thread.
+        const script = document.createElement('script');
+        script.src = 'render_worker.js';
+        script.onload = () => {
+            const renderer = createRenderer(lidar, imu, handleRendererMessage);
+            renderer.resize(sizes());
+            renderer.connect(WS_URL, SUBSCRIPTION);
+            resize = renderer.resize;
+        };
+        document.head.appendChild(script);
     }
-    lastPacketTime = now;
-    packetsReceived++;
-
-    if (now - lastVisualUpdate < VISUAL_UPDATE_MS) return;
-    lastVisualUpdate = now;
 
-    document.getElementById('vehicleId').textContent = data.vehicle_id;
-    updateLidar(data.lidar_scan);
-    updateIMU(data.imu_reading);
-    updateBattery(data.battery_level);
-    updateMetrics(data.timestamp);
+    const observer = new ResizeObserver(() => resize?.(sizes()));
+    observer.observe(lidar);
+    observer.observe(imu);
 }
 
-function updateLidar(scan) {
-    if (!scan?.length) return;
-
-    const step = 8;
-    const data = [], labels = [], colors = [];
-
-    for (let i = 0; i < scan.length; i += step) {
-        data.push(scan[i]);
-        labels.push(`${Math.round(i / scan.length * 360)}°`);
-        colors.push(`hsla(${180 + (i / scan.length) * 60}, 80%, 50%, 0.7)`);
+function handleRendererMessage(msg) {
+    if (msg.type === 'status') {
+        setStatus(msg.status);
+        if (msg.status === 'connected') startTime = Date.now();
+    } else if (msg.type === 'summary') {
+        document.getElementById('vehicleId').textContent = msg.vehicle_id;
+        document.getElementById('lidarPoints').textContent = `${msg.points} pts`;
+        updateIMU(msg.imu);
+        updateBattery(msg.battery);
+        updateMetrics(msg);
     }
-
-    lidarChart.data.labels = labels;
-    lidarChart.data.datasets[0].data = data;
-    lidarChart.data.datasets[0].backgroundColor = colors;
-    lidarChart.update('none');
-
-    document.getElementById('lidarPoints').textContent = `${scan.length} pts`;
 }
 
 function updateIMU(imu) {
     if (!imu) return;
-
     document.getElementById('imuX').textContent = imu.accel_x.toFixed(3);
     document.getElementById('imuY').textContent = imu.accel_y.toFixed(3);
     document.getElementById('imuZ').textContent = imu.accel_z.toFixed(3);
-
-    imuHistory.labels.push('');
-    imuHistory.x.push(imu.accel_x);
-    imuHistory.y.push(imu.accel_y);
-    imuHistory.z.push(imu.accel_z);
-
-    if (imuHistory.labels.length > 100) {
-        imuHistory.labels.shift();
-        imuHistory.x.shift();
-        imuHistory.y.shift();
-        imuHistory.z.shift();
-    }
-
-    imuChart.update('none');
 }
 
 function updateBattery(level) {
@@ -155,15 +105,10 @@ function updateBattery(level) {
     document.getElementById('range').textContent = `${Math.round(pct * 1.5)} km`;
 }
 
-function updateMetrics(timestamp) {
-    if (tickTimes.length) {
-        const avg = tickTimes.reduce((a, b) => a + b) / tickTimes.length;
-        document.getElementById('tickRate').textContent = Math.round(1000 / avg);
-    }
-
-    const latency = Math.max(0, (Date.now() * 1000 - timestamp) / 1000);
-    document.getElementById('latency').textContent = latency.toFixed(1);
-    document.getElementById('packetsTotal').textContent = formatNum(packetsReceived);
+function updateMetrics(msg) {
+    if (msg.tick_hz) document.getElementById('tickRate').textContent = msg.tick_hz;
+    document.getElementById('latency').textContent = msg.latency_ms.toFixed(1);
+    document.getElementById('packetsTotal').textContent = formatNum(msg.packets);
 }
 
 function setStatus(status) {
@@ -0,0 +1,435 @@
+/**
+ * OmniStream dashboard renderer.
+ *
+ * Runs as a dedicated Web Worker that owns the WebSocket and both plots
+ * (as OffscreenCanvases), so decoding and drawing never hold up the page.
+ * Messages only update state; drawing happens once per animation frame,
+ * with the newest scan only: scans that arrive between two frames are
+ * skipped. The LiDAR plot repaints just the bars that moved, and the IMU
+ * strip chart scrolls its pixels and draws only the new segments. The page
+ * gets a small summary for its text panels a few times a second.
+ *
+ * Without OffscreenCanvas the page loads this file as a plain script and
+ * runs createRenderer() on its own thread instead, so everything but that
+ * function stays inside the closure below.
+ */
+
+(() => {
+    const LIDAR_BARS = 128;
+    const LIDAR_MAX_M = 15;
+    const LIDAR_RING_M = 5;
+    const IMU_HISTORY = 100;
+    const IMU_SERIES = [
+        { label: 'X', color: '#ff6b6b' },
+        { label: 'Y', color: '#4ecdc4' },
+        { label: 'Z', color: '#ffe66d' }
+    ];
+    const SUMMARY_INTERVAL_MS = 100;
+    const RECONNECT_MS = 2000;
+    const GRID_COLOR = 'rgba(255, 255, 255, 0.1)';
+    const LABEL_COLOR = 'rgba(255, 255, 255, 0.4)';
+
+    const nextFrame = typeof requestAnimationFrame === 'function'
+        ? (cb) => requestAnimationFrame(cb)
+        : (cb) => setTimeout(cb, 16);
+
+    // Binary telemetry frame from the C++ bridge (see dashboard_protocol.hpp).
+    // The LiDAR samples are viewed in place; q16 samples are scaled on use.
+    const textDecoder = new TextDecoder();
+
+    function decodeBinaryTelemetry(buf) {
+        const view = new DataView(buf);
+        if (view.getUint8(0) !== 1) return null;
+        const quantized = view.getUint8(1) === 1;
+        const points = view.getUint32(4, true);
+        const idLen = view.getUint16(52, true);
+        const offset = 56 + ((idLen + 3) & ~3);
+        return {
+            vehicle_id: textDecoder.decode(new Uint8Array(buf, 56, idLen)),
+            timestamp: view.getFloat64(8, true),
+            tick: view.getFloat64(16, true),
+            imu_reading: {
+                accel_x: view.getFloat32(24, true),
+                accel_y: view.getFloat32(28, true),
+                accel_z: view.getFloat32(32, true)
+            },
+            battery_level: view.getFloat32(36, true),
+            lidar_scale: view.getFloat32(40, true),
+            lidar_sector: [view.getFloat32(44, true), view.getFloat32(48, true)],
+            lidar_minmax: (view.getUint8(2) & 1) === 1,
+            lidar_scan: quantized ? new Uint16Array(buf, offset, points)
+                                  : new Float32Array(buf, offset, points)
+        };
+    }
+
+    // Polar bar plot of the scan, one wedge per bar clockwise from the top.
+    // Only wedges whose length changed by half a pixel or more are repainted.
+    class LidarPlot {
+        constructor(canvas) {
+            this.canvas = canvas;
+            this.ctx = canvas.getContext('2d');
+            this.radii = new Float32Array(0); // Drawn bar lengths in pixels
+            this.colors = [];
+            this.valid = false;               // False forces a full repaint
+        }
+
+        resize(width, height) {
+            this.canvas.width = width;
+            this.canvas.height = height;
+            this.valid = false;
+        }
+
+        // Each bar shows the closest return in its slice of the scan, so
+        // obstacles survive both bridge downsampling and this one. Returns the
+        // number of bars repainted.
+        draw(scan, scale) {
+            const bars = Math.min(LIDAR_BARS, scan.length);
+            const { width, height } = this.canvas;
+            const cx = width / 2, cy = height / 2;
+            const rmax = Math.max(1, Math.min(cx, cy) - 2);
+
+            if (!this.valid || this.radii.length !== bars) {
+                this.radii = new Float32Array(bars).fill(-1);
+                this.colors = Array.from({ length: bars },
+                    (_, b) => `hsl(${180 + (b / bars) * 60}, 80%, 38%)`);
+                this.ctx.clearRect(0, 0, width, height);
+                this.valid = true;
+            }
+
+            let painted = 0;
+            for (let b = 0; b < bars; b++) {
+                const lo = Math.floor(b * scan.length / bars);
+                const hi = Math.floor((b + 1) * scan.length / bars);
+                let min = Infinity;
+                for (let i = lo; i < hi; i++) if (scan[i] < min) min = scan[i];
+                const r = Math.min(min * scale, LIDAR_MAX_M) / LIDAR_MAX_M * rmax;
+                if (Math.abs(r - this.radii[b]) < 0.5) continue;
+                this.paintBar(b, bars, r, cx, cy, rmax);
+                this.radii[b] = r;
+                painted++;
+            }
+            return painted;
+        }
+
+        // Clears the bar's sector and redraws its range rings and wedge inside it.
+        paintBar(b, bars, r, cx, cy, rmax) {
+            const ctx = this.ctx;
+            const a0 = -Math.PI / 2 + (b / bars) * 2 * Math.PI;
+            const a1 = a0 + (2 * Math.PI) / bars;
+
+            ctx.save();
+            ctx.beginPath();
+            ctx.moveTo(cx, cy);
+            ctx.arc(cx, cy, rmax + 1, a0, a1);
+            ctx.closePath();
+            ctx.clip();
+            ctx.clearRect(cx - rmax - 1, cy - rmax - 1, 2 * rmax + 2, 2 * rmax + 2);
+
+            ctx.strokeStyle = GRID_COLOR;
+            ctx.lineWidth = 1;
+            for (let m = LIDAR_RING_M; m <= LIDAR_MAX_M; m += LIDAR_RING_M) {
+                ctx.beginPath();
+                ctx.arc(cx, cy, (m / LIDAR_MAX_M) * rmax, a0, a1);
+                ctx.stroke();
+            }
+
+            if (r > 0) {
+                ctx.beginPath();
+                ctx.moveTo(cx, cy);
+                ctx.arc(cx, cy, r, a0, a1);
+                ctx.closePath();
+                ctx.fillStyle = this.colors[b];
+                ctx.fill();
+            }
+            ctx.restore();
+        }
+    }
+
+    // Scrolling line chart of the last IMU_HISTORY samples. New samples shift
+    // the plotted pixels left by whole steps and draw only the new segments;
+    // the plot is repainted in full when the value range changes.
+    class StripChart {
+        constructor(canvas, series) {
+            this.canvas = canvas;
+            this.ctx = canvas.getContext('2d');
+            this.series = series;
+            this.history = series.map(() => []);
+            this.pending = 0; // Samples pushed since the last draw
+            this.valid = false;
+            this.dpr = 1;
+            this.lo = 0;
+            this.hi = 0;
+        }
+
+        resize(width, height, dpr) {
+            this.canvas.width = width;
+            this.canvas.height = height;
+            this.dpr = dpr;
+            this.valid = false;
+        }
+
+        push(values) {
+            values.forEach((v, i) => {
+                const h = this.history[i];
+                h.push(v);
+                if (h.length > IMU_HISTORY) h.shift();
+            });
+            this.pending++;
+        }
+
+        draw() {
+            if (this.valid && this.pending === 0) return;
+            const [lo, hi] = this.range();
+            const n = this.history[0].length;
+            if (!this.valid || lo !== this.lo || hi !== this.hi ||
+                this.pending >= n - 1) {
+                this.lo = lo;
+                this.hi = hi;
+                this.repaint();
+            } else {
+                this.scroll(this.pending);
+            }
+            this.pending = 0;
+        }
+
+        // Whole m/s^2 bounds with a margin around every sample shown.
+        range() {
+            let min = Infinity, max = -Infinity;
+            for (const h of this.history)
+                for (const v of h) {
+                    if (v < min) min = v;
+                    if (v > max) max = v;
+                }
+            if (min > max) return [-1, 1];
+            return [Math.floor(min) - 1, Math.ceil(max) + 1];
+        }
+
+        geometry() {
+            const { width, height } = this.canvas;
+            const d = this.dpr;
+            const left = 32 * d, right = width - 4 * d;
+            const top = 18 * d, bottom = height - 4 * d;
+            const step = Math.max(1, Math.floor((right - left) / (IMU_HISTORY - 1)));
+            return { width, height, left, right, top, bottom, step };
+        }
+
+        y(v, g) {
+            return g.top + ((this.hi - v) / (this.hi - this.lo)) * (g.bottom - g.top);
+        }
+
+        ticks() {
+            const span = this.hi - this.lo;
+            const every = span > 20 ? 10 : span > 8 ? 5 : span > 4 ? 2 : 1;
+            const out = [];
+            for (let v = Math.ceil(this.lo / every) * every; v <= this.hi; v += every)
+                out.push(v);
+            return out;
+        }
+
+        repaint() {
+            const ctx = this.ctx;
+            const g = this.geometry();
+            const d = this.dpr;
+            ctx.clearRect(0, 0, g.width, g.height);
+
+            ctx.font = `${11 * d}px sans-serif`;
+            ctx.textBaseline = 'middle';
+            let x = g.left;
+            for (const s of this.series) {
+                ctx.fillStyle = s.color;
+                ctx.fillRect(x, 5 * d, 10 * d, 3 * d);
+                ctx.fillStyle = LABEL_COLOR;
+                ctx.fillText(s.label, x + 14 * d, 7 * d);
+                x += 36 * d;
+            }
+            ctx.textAlign = 'right';
+            for (const v of this.ticks())
+                ctx.fillText(String(v), g.left - 6 * d, this.y(v, g));
+            ctx.textAlign = 'left';
+
+            this.grid(g, g.left, g.right);
+            const n = this.history[0].length;
+            this.segments(g, 0, n);
+            this.valid = true;
+        }
+
+        // Moves the plot left by k steps and draws the k newest segments.
+        scroll(k) {
+            const ctx = this.ctx;
+            const g = this.geometry();
+            const dx = k * g.step;
+            const w = g.right - g.left + 2 * this.dpr;
+            // The plot rows only, plus room for line width; the legend
+            // above them stays put.
+            const y = g.top - 2 * this.dpr;
+            const h = g.bottom - g.top + 4 * this.dpr;
+            ctx.save();
+            ctx.beginPath();
+            ctx.rect(g.left, y, w, h);
+            ctx.clip();
+            // 'copy' also clears the strip the shifted image no longer covers.
+            ctx.globalCompositeOperation = 'copy';
+            ctx.drawImage(this.canvas, g.left + dx, y, w - dx, h,
+                          g.left, y, w - dx, h);
+            ctx.restore();
+
+            this.grid(g, g.right - dx, g.right);
+            const n = this.history[0].length;
+            this.segments(g, n - 1 - k, n);
+        }
+
+        grid(g, x0, x1) {
+            const ctx = this.ctx;
+            ctx.strokeStyle = GRID_COLOR;
+            ctx.lineWidth = 1;
+            ctx.beginPath();
+            for (const v of this.ticks()) {
+                const y = Math.round(this.y(v, g)) + 0.5;
+                ctx.moveTo(x0, y);
+                ctx.lineTo(x1, y);
+            }
+            ctx.stroke();
+        }
+
+        // Strokes samples [from, to) of every series, newest at the right edge.
+        segments(g, from, to) {
+            const ctx = this.ctx;
+            const n = this.history[0].length;
+            from = Math.max(0, from);
+            ctx.lineWidth = 1.5 * this.dpr;
+            ctx.lineJoin = 'round';
+            this.series.forEach((s, i) => {
+                const h = this.history[i];
+                ctx.strokeStyle = s.color;
+                ctx.beginPath();
+                for (let j = from; j < to; j++) {
+                    const x = g.right - (n - 1 - j) * g.step;
+                    const y = this.y(h[j], g);
+                    if (j === from) ctx.moveTo(x, y);
+                    else ctx.lineTo(x, y);
+                }
+                ctx.stroke();
+            });
+        }
+    }
+
+    // Owns the connection and both plots. `post` receives status and summary
+    // messages for the page; returns { connect, resize }.
+    function createRenderer(lidarCanvas, imuCanvas, post) {
+        const lidar = new LidarPlot(lidarCanvas);
+        const imu = new StripChart(imuCanvas, IMU_SERIES);
+        let latest = null;    // Newest frame not drawn yet
+        let shown = null;     // Frame on screen, redrawn after a resize
+        let scheduled = false;
+        let packets = 0, skipped = 0;
+        let lastArrival = 0, lastSummary = 0;
+        const intervals = [];
+
+        function onTelemetry(data) {
+            const now = Date.now();
+            if (lastArrival) {
+                intervals.push(now - lastArrival);
+                if (intervals.length > 60) intervals.shift();
+            }
+            lastArrival = now;
+            packets++;
+            const r = data.imu_reading;
+            if (r) imu.push([r.accel_x, r.accel_y, r.accel_z]);
+            if (latest) skipped++;
+            latest = data;
+            schedule();
+        }
+
+        function schedule() {
+            if (scheduled) return;
+            scheduled = true;
+            nextFrame(render);
+        }
+
+        function render() {
+            scheduled = false;
+            const frame = latest ?? shown;
+            latest = null;
+            if (frame?.lidar_scan?.length)
+                lidar.draw(frame.lidar_scan, frame.lidar_scale ?? 1);
+            imu.draw();
+            if (frame && frame !== shown) {
+                shown = frame;
+                summarize(frame);
+            }
+        }
+
+        function summarize(frame) {
+            const now = Date.now();
+            if (now - lastSummary < SUMMARY_INTERVAL_MS) return;
+            lastSummary = now;
+            const avg = intervals.length
+                ? intervals.reduce((a, b) => a + b) / intervals.length : 0;
+            post({
+                type: 'summary',
+                vehicle_id: frame.vehicle_id,
+                imu: frame.imu_reading,
+                battery: frame.battery_level,
+                points: frame.lidar_scan?.length ?? 0,
+                latency_ms: Math.max(0, (now * 1000 - frame.timestamp) / 1000),
+                tick_hz: avg ? Math.round(1000 / avg) : 0,
+                packets,
+                skipped
+            });
+        }
+
+        function connect(url, subscription) {
+            post({ type: 'status', status: 'connecting' });
+            const ws = new WebSocket(url);
+            ws.binaryType = 'arraybuffer';
+
+            ws.onopen = () => {
+                post({ type: 'status', status: 'connected' });
+                ws.send(JSON.stringify(subscription));
+            };
+
+            ws.onclose = () => {
+                post({ type: 'status', status: 'disconnected' });
+                setTimeout(() => connect(url, subscription), RECONNECT_MS);
+            };
+
+            ws.onerror = () => post({ type: 'status', status: 'error' });
+
+            ws.onmessage = (e) => {
+                if (e.data instanceof ArrayBuffer) {
+                    const data = decodeBinaryTelemetry(e.data);
+                    if (data) onTelemetry(data);
+                    return;
+                }
+                const msg = JSON.parse(e.data);
+                if (msg.type === 'telemetry') onTelemetry(msg.data);
+            };
+        }
+
+        // `sizes` holds CSS pixel sizes; the backing stores use device pixels.
+        function resize(sizes) {
+            const d = sizes.dpr || 1;
+            lidar.resize(Math.round(sizes.lidar[0] * d), Math.round(sizes.lidar[1] * d));
+            imu.resize(Math.round(sizes.imu[0] * d), Math.round(sizes.imu[1] * d), d);
+            schedule();
+        }
+
+        return { connect, resize };
+    }
+
+    if (typeof WorkerGlobalScope !== 'undefined' && self instanceof WorkerGlobalScope) {
+        let renderer = null;
+        self.onmessage = (e) => {
+            const msg = e.data;
+            if (msg.type === 'start') {
+                renderer = createRenderer(msg.lidar, msg.imu, (m) => self.postMessage(m));
+                renderer.resize(msg.sizes);
+                renderer.connect(msg.url, msg.subscription);
+            } else if (msg.type === 'resize') {
+                renderer?.resize(msg.sizes);
+            }
+        };
+    } else {
+        self.createRenderer = createRenderer;
+    }
+})();
@@ -2,7 +2,9 @@
 OmniStream Dashboard Server
 
 Bridges telemetry from the C++ gRPC agent to browser dashboards via WebSocket.
-Supports both live gRPC mode and standalone simulation for demos.
+Supports both live gRPC mode and standalone simulation for demos. For live
+fleets, use the C++ omnistream_bridge, which serves the agent's stream and
+speaks the same WebSocket protocol without per-frame JSON cost in Python.
 """
 
 import asyncio
@@ -65,13 +67,65 @@ class TelemetrySimulator:
         }
 
 
+class LidarDecoder:
+    """Reconstructs LIDAR_DELTA_Q16 scans; one instance per vehicle.
+
+    Keyframes are delta-coded along the scan, other frames against the
+    previous scan. After a sequence gap, frames are skipped until a keyframe.
+    Frames older than the last one seen (resent after a reconnect) are
+    skipped without losing sync; keyframe 0 means the sender restarted.
+    """
+
+    DELTA_Q16 = 1
+
+    def __init__(self):
+        self.prev = None
+        self.next_sequence = None
+
+    def decode(self, packet):
+        """Returns the scan as a list of floats, or None if it cannot be rebuilt."""
+        if packet.lidar_encoding != self.DELTA_Q16:
+            return list(packet.lidar_scan)
+
+        seq = packet.lidar_sequence
+        if (self.next_sequence is not None and seq < self.next_sequence
+                and not (packet.lidar_keyframe and seq == 0)):
+            return None
+
+        deltas = packet.lidar_quantized
+        in_order = (self.prev is not None
+                    and packet.lidar_sequence == self.next_sequence
+                    and len(self.prev) == len(deltas))
+        self.next_sequence = packet.lidar_sequence + 1
+
+        if packet.lidar_keyframe:
+            values, last = [], 0
+            for d in deltas:
+                last += d
+                values.append(last)
+        elif in_order:
+            values = [p + d for p, d in zip(self.prev, deltas)]
+        else:
+            self.prev = None
+            return None
+
+        self.prev = values
+        step = packet.lidar_quant_step
+        return [v * step for v in values]
+
+
 class GrpcReceiver:
     """Receives telemetry from C++ agent via gRPC streaming."""
+
+    CHANNEL_IMU = 1
+    CHANNEL_LIDAR = 2
     
     def __init__(self, server_address="localhost:50051"):
         self.server_address = server_address
         self.channel = None
         self.stub = None
+        self.decoders = {}
+        self.latest = {}
     
     def connect(self):
         if not GRPC_AVAILABLE:
@@ -94,18 +148,30 @@ class GrpcReceiver:
         
         try:
             for packet in self.stub.StreamTelemetry(iter([])):
-                yield {
+                # Multi-rate agents send IMU and LiDAR as separate packets;
+                # merge them into the latest full view of each vehicle.
+                state = self.latest.setdefault(packet.vehicle_id, {
                     "vehicle_id": packet.vehicle_id,
-                    "timestamp": packet.timestamp,
-                    "lidar_scan": list(packet.lidar_scan),
-                    "imu_reading": {
+                    "lidar_scan": [],
+                    "imu_reading": {},
+                    "battery_level": 0.0,
+                    "tick": 0
+                })
+                state["timestamp"] = packet.timestamp
+                if packet.channel != self.CHANNEL_IMU:
+                    decoder = self.decoders.setdefault(packet.vehicle_id, LidarDecoder())
+                    scan = decoder.decode(packet)
+                    if scan is None:
+                        continue
+                    state["lidar_scan"] = scan
+                if packet.channel != self.CHANNEL_LIDAR:
+                    state["imu_reading"] = {
                         "accel_x": packet.imu_reading.accel_x,
                         "accel_y": packet.imu_reading.accel_y,
                         "accel_z": packet.imu_reading.accel_z,
-                    },
-                    "battery_level": packet.battery_level,
-                    "tick": 0
-                }
+                    }
+                    state["battery_level"] = packet.battery_level
+                yield dict(state)
         except grpc.RpcError as e:
             print(f"[gRPC] Stream error: {e}")
 
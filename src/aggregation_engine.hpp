@@ -0,0 +1,313 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "telemetry.pb.h"
+
+namespace omnistream {
+
+// The last `capacity` values pushed; push() hands back the one it evicts.
+template <typename T> class RingWindow {
+public:
+  explicit RingWindow(size_t capacity)
+      : ring_(std::max<size_t>(1, capacity)) {}
+
+  // Returns true and sets *evicted when the window was already full.
+  bool push(const T &value, T *evicted) {
+    bool full = size_ == ring_.size();
+    if (full)
+      *evicted = ring_[head_];
+    ring_[head_] = value;
+    head_ = (head_ + 1) % ring_.size();
+    size_ += full ? 0 : 1;
+    return full;
+  }
+
+  size_t size() const { return size_; }
+  const T &oldest() const {
+    return ring_[(head_ + ring_.size() - size_) % ring_.size()];
+  }
+  const T &newest() const {
+    return ring_[(head_ + ring_.size() - 1) % ring_.size()];
+  }
+
+private:
+  std::vector<T> ring_;
+  size_t head_ = 0; // Next slot to write
+  size_t size_ = 0;
+};
+
+// Minimum (or, with std::greater, maximum) of the last `window` values in
+// amortized O(1) per push: a monotonic queue of the candidates that can
+// still become the extreme, kept in a fixed ring.
+template <typename T, typename Compare = std::less<T>> class SlidingExtreme {
+public:
+  explicit SlidingExtreme(size_t window)
+      : window_(std::max<size_t>(1, window)), ring_(window_) {}
+
+  void push(T value) {
+    if (size_ > 0 && at(0).seq + window_ <= seq_)
+      pop_front();
+    while (size_ > 0 && !Compare()(at(size_ - 1).value, value))
+      size_--;
+    ring_[(head_ + size_) % ring_.size()] = {seq_++, value};
+    size_++;
+  }
+
+  bool empty() const { return size_ == 0; }
+  T value() const { return at(0).value; }
+
+private:
+  struct Entry {
+    uint64_t seq;
+    T value;
+  };
+
+  const Entry &at(size_t i) const { return ring_[(head_ + i) % ring_.size()]; }
+  void pop_front() {
+    head_ = (head_ + 1) % ring_.size();
+    size_--;
+  }
+
+  size_t window_;
+  std::vector<Entry> ring_;
+  size_t head_ = 0;
+  size_t size_ = 0;
+  uint64_t seq_ = 0;
+};
+
+// Counts of ranges in fixed 0.5 m bins up to 128 m, for percentile queries
+// over a sliding window: add() and remove() are O(1), percentile() walks
+// the bins and is meant for the low summary rate.
+class RangeHistogram {
+public:
+  static constexpr size_t kBins = 256;
+  static constexpr float kBinMetres = 0.5f;
+
+  void add(float range) {
+    counts_[bin(range)]++;
+    total_++;
+  }
+
+  void remove(float range) {
+    counts_[bin(range)]--;
+    total_--;
+  }
+
+  // Midpoint of the bin holding the q-quantile (0..1); NaN when empty.
+  float percentile(float q) const {
+    if (total_ == 0)
+      return NAN;
+    uint64_t rank = static_cast<uint64_t>(q * (total_ - 1));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kBins; ++i) {
+      seen += counts_[i];
+      if (seen > rank)
+        return (i + 0.5f) * kBinMetres;
+    }
+    return kBins * kBinMetres;
+  }
+
+private:
+  static size_t bin(float range) {
+    return std::min(kBins - 1,
+                    static_cast<size_t>(std::max(0.0f, range) / kBinMetres));
+  }
+
+  std::array<uint32_t, kBins> counts_{};
+  uint64_t total_ = 0;
+};
+
+struct AggregationConfig {
+  size_t imu_window = 300;  // IMU samples (5 s at 60 Hz)
+  size_t lidar_window = 60; // Scans (1 s at 60 Hz)
+  size_t sectors = 8;       // Equal LiDAR sectors, the first starting at 0°
+  float percentile = 0.1f;  // Reported per sector next to the minimum
+};
+
+// One vehicle's windows, as published to fleet dashboards. Sector values
+// are NaN until the sector has seen a return.
+struct VehicleSummary {
+  std::string vehicle_id;
+  int64_t timestamp = 0; // Of the last packet
+  uint64_t packets = 0;
+  float imu_mean = 0, imu_max = 0, imu_stddev = 0; // |accel|, m/s^2
+  float battery = 0;
+  float drain_per_min = 0; // Battery percent per minute over the window
+  std::vector<float> sector_min;
+  std::vector<float> sector_percentile;
+};
+
+// Rolling statistics for one vehicle. Every window is a fixed ring sized
+// at construction, so an update touches O(1) state per IMU sample and per
+// sector; only the per-scan sector minimum walks the scan.
+class VehicleWindows {
+public:
+  explicit VehicleWindows(const AggregationConfig &config)
+      : config_(config), imu_(config.imu_window),
+        imu_max_(config.imu_window), battery_(config.imu_window) {
+    sectors_.reserve(config.sectors);
+    for (size_t s = 0; s < config.sectors; ++s)
+      sectors_.emplace_back(config.lidar_window);
+  }
+
+  void update(const TelemetryPacket &packet, const std::vector<float> *scan) {
+    timestamp_ = packet.timestamp();
+    packets_++;
+    if (packet.channel() != TelemetryPacket::CHANNEL_LIDAR)
+      add_imu(packet);
+    if (scan)
+      add_scan(*scan);
+  }
+
+  void summarize(VehicleSummary *out) const {
+    out->timestamp = timestamp_;
+    out->packets = packets_;
+    if (size_t n = imu_.size()) {
+      double mean = imu_sum_ / n;
+      out->imu_mean = static_cast<float>(mean);
+      out->imu_stddev = static_cast<float>(
+          std::sqrt(std::max(0.0, imu_sum_sq_ / n - mean * mean)));
+      out->imu_max = imu_max_.value();
+    }
+    if (battery_.size() > 0) {
+      const BatterySample &first = battery_.oldest();
+      const BatterySample &last = battery_.newest();
+      out->battery = last.level;
+      double minutes = (last.timestamp - first.timestamp) / 60e6;
+      if (minutes > 0)
+        out->drain_per_min =
+            static_cast<float>((first.level - last.level) / minutes);
+    }
+    out->sector_min.clear();
+    out->sector_percentile.clear();
+    for (const auto &s : sectors_) {
+      out->sector_min.push_back(s.min.empty() ? NAN : s.min.value());
+      out->sector_percentile.push_back(s.hist.percentile(config_.percentile));
+    }
+  }
+
+private:
+  struct BatterySample {
+    int64_t timestamp = 0;
+    float level = 0;
+  };
+
+  // Nearest return per scan in one sector, over the last lidar_window scans.
+  struct Sector {
+    explicit Sector(size_t window) : ranges(window), min(window) {}
+    RingWindow<float> ranges;
+    SlidingExtreme<float> min;
+    RangeHistogram hist;
+  };
+
+  void add_imu(const TelemetryPacket &packet) {
+    const auto &imu = packet.imu_reading();
+    double mag = std::sqrt(double(imu.accel_x()) * imu.accel_x() +
+                           double(imu.accel_y()) * imu.accel_y() +
+                           double(imu.accel_z()) * imu.accel_z());
+    double evicted = 0;
+    if (imu_.push(mag, &evicted)) {
+      imu_sum_ -= evicted;
+      imu_sum_sq_ -= evicted * evicted;
+    }
+    imu_sum_ += mag;
+    imu_sum_sq_ += mag * mag;
+    imu_max_.push(static_cast<float>(mag));
+
+    BatterySample dropped;
+    battery_.push({packet.timestamp(), packet.battery_level()}, &dropped);
+  }
+
+  void add_scan(const std::vector<float> &scan) {
+    const size_t n = scan.size(), sectors = sectors_.size();
+    for (size_t s = 0; s < sectors; ++s) {
+      size_t lo = s * n / sectors, hi = (s + 1) * n / sectors;
+      float nearest = INFINITY;
+      for (size_t i = lo; i < hi; ++i)
+        if (scan[i] > 0.0f)
+          nearest = std::min(nearest, scan[i]);
+      if (!std::isfinite(nearest))
+        continue;
+      Sector &sector = sectors_[s];
+      float evicted = 0;
+      if (sector.ranges.push(nearest, &evicted))
+        sector.hist.remove(evicted);
+      sector.hist.add(nearest);
+      sector.min.push(nearest);
+    }
+  }
+
+  const AggregationConfig &config_;
+  RingWindow<double> imu_;
+  SlidingExtreme<float, std::greater<float>> imu_max_;
+  double imu_sum_ = 0, imu_sum_sq_ = 0;
+  RingWindow<BatterySample> battery_;
+  std::vector<Sector> sectors_;
+  int64_t timestamp_ = 0;
+  uint64_t packets_ = 0;
+};
+
+// Per-vehicle rolling windows over every ingested packet. Ingest threads
+// call update(); vehicles are spread over lock stripes so concurrent
+// streams rarely contend. summaries() is the low-rate read side.
+class AggregationEngine {
+public:
+  static constexpr size_t kStripes = 16;
+
+  explicit AggregationEngine(const AggregationConfig &config = {})
+      : config_(config) {}
+
+  void update(const TelemetryPacket &packet, const std::vector<float> *scan) {
+    Stripe &stripe = stripes_[std::hash<std::string>{}(packet.vehicle_id()) %
+                              kStripes];
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    auto it = stripe.vehicles.find(packet.vehicle_id());
+    if (it == stripe.vehicles.end())
+      it = stripe.vehicles
+               .emplace(packet.vehicle_id(),
+                        std::make_unique<VehicleWindows>(config_))
+               .first;
+    it->second->update(packet, scan);
+  }
+
+  // Current summary of every vehicle, in vehicle id order.
+  std::vector<VehicleSummary> summaries() const {
+    std::vector<VehicleSummary> out;
+    for (const auto &stripe : stripes_) {
+      std::lock_guard<std::mutex> lock(stripe.mutex);
+      for (const auto &[id, windows] : stripe.vehicles) {
+        out.emplace_back();
+        out.back().vehicle_id = id;
+        windows->summarize(&out.back());
+      }
+    }
+    std::sort(out.begin(), out.end(),
+              [](const VehicleSummary &a, const VehicleSummary &b) {
+                return a.vehicle_id < b.vehicle_id;
+              });
+    return out;
+  }
+
+  const AggregationConfig &config() const { return config_; }
+
+private:
+  struct Stripe {
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, std::unique_ptr<VehicleWindows>> vehicles;
+  };
+
+  const AggregationConfig config_;
+  std::array<Stripe, kStripes> stripes_;
+};
+
+} // namespace omnistream
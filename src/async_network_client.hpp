@@ -0,0 +1,370 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "capture_clock.hpp"
+#include "channel_config.hpp"
+#include "connection_manager.hpp"
+#include "logger.hpp"
+#include "metrics.hpp"
+#include "packet_queue.hpp"
+#include "shutdown.hpp"
+#include "telemetry.grpc.pb.h"
+#include "telemetry.pb.h"
+#include "wire_packet.hpp"
+#include <grpcpp/grpcpp.h>
+
+namespace omnistream {
+
+// Asynchronous gRPC streaming client driven by a CompletionQueue.
+//
+// A read for the next ServerAck is always outstanding, so acks are consumed
+// while writes are in flight. The server acks packets in order; each ack is
+// matched against the oldest unacked packet to compute round-trip time and
+// to feed a ClockOffsetEstimator with (send, server receive, ack)
+// timestamps. Delivery latency is ServerAck.received_timestamp minus the
+// packet's monotonic capture time mapped onto the server's clock, so it is
+// not thrown off by the agent's wall clock being skewed or stepped.
+// At most `window` packets may be unacked: once the window is full the client
+// stops popping, so a slow server backs up the queue instead of the client.
+// After queue shutdown the window is ignored so the backlog still drains.
+//
+// Unacked packets keep their serialized bytes. When the stream breaks, the
+// client waits for the ConnectionManager to reconnect and resends them on
+// the new stream before taking new packets, so a link flap loses nothing
+// (the server may see a packet twice if only its ack was lost). Cancelling
+// the DrainCancel ends the post-shutdown drain early: the RPC is cancelled
+// and whatever is unacked or still queued is counted as lost.
+class AsyncNetworkClient {
+public:
+  static constexpr auto kConnectTimeout = std::chrono::seconds(2);
+
+  explicit AsyncNetworkClient(const std::string &address, size_t window = 64,
+                              ChannelConfig config = {},
+                              BackoffPolicy backoff = {})
+      : address_(address), window_(std::max<size_t>(1, window)),
+        config_(std::move(config)), backoff_(backoff), sent_(0), acked_(0) {}
+
+  // Returns whether the server answered within kConnectTimeout; stream()
+  // keeps retrying either way.
+  bool connect() {
+    conn_ = std::make_unique<ConnectionManager>(address_, config_, backoff_);
+    conn_->set_link_state(link_);
+    stub_ = std::make_unique<RawTelemetryStub>(conn_->channel());
+    bool ready = conn_->connect(kConnectTimeout);
+    log_info("Network") << (ready ? "Connected to " : "Waiting for ")
+                        << address_ << " (async, window " << window_ << ")";
+    return ready;
+  }
+
+  // Streams until the queue is closed and drained, reopening the stream
+  // after failures. Gives up waiting for the server once shutdown starts.
+  void stream(PacketQueue &queue) {
+    while (!run_stream(queue)) {
+      conn_->stream_failed();
+      if (queue.closed() && in_flight_.empty())
+        break;
+      if (!conn_->await_retry([&] { return queue.is_shutdown(); })) {
+        uint64_t unacked = in_flight_.size(), queued = 0;
+        while (queue.try_pop())
+          queued++;
+        lost_ = unacked + queued;
+        in_flight_.clear();
+        publish_outstanding();
+        log_warn("Network", "Shutdown while disconnected; packets lost")
+            .field("unacked", unacked)
+            .field("queued", queued);
+        break;
+      }
+    }
+    log_info("Network", "Stream done")
+        .field("sent", sent_.load())
+        .field("resent", resent_)
+        .field("reconnects", conn_->reconnects());
+    if (offset_.valid())
+      log_info("Network", "Server clock offset")
+          .field("offset_us", offset_.offset())
+          .field("error_us", offset_.error_bound())
+          .field("acks", offset_.samples());
+  }
+
+  void set_drain_cancel(DrainCancel *cancel) { cancel_ = cancel; }
+  // Call before connect().
+  void set_link_state(LinkState *link) { link_ = link; }
+
+  uint64_t sent() const { return sent_; }
+  uint64_t acked() const { return acked_; }
+  // Unacked or queued packets given up at shutdown.
+  uint64_t lost() const { return lost_; }
+
+private:
+  using Stream = RawTelemetryStub::AsyncWriter;
+
+  enum class Op : intptr_t { Start = 1, Write, Read, WritesDone, Finish };
+
+  struct InFlight {
+    int64_t capture_us; // capture_monotonic
+    int64_t sent_us;    // CaptureClock time of the last write
+    grpc::ByteBuffer bytes; // Shares the slices handed to gRPC
+  };
+
+  static constexpr std::chrono::milliseconds kPollInterval{1};
+  // gRPC rounds a CompletionQueue deadline up to the next millisecond, so
+  // polling with a deadline of now() sleeps for up to 1 ms. A deadline in the
+  // past polls without waiting.
+  static constexpr std::chrono::system_clock::time_point kNoWait{};
+
+  static void *tag(Op op) {
+    return reinterpret_cast<void *>(static_cast<intptr_t>(op));
+  }
+
+  // One RPC. Returns true if it ended cleanly after the queue was closed.
+  bool run_stream(PacketQueue &queue) {
+    grpc::ClientContext ctx;
+    grpc::CompletionQueue cq;
+    config_.apply(ctx);
+    DrainCancel::Scope cancellable(cancel_, &ctx);
+    auto rw = stub_->PrepareAsyncStreamTelemetry(&ctx, &cq);
+    grpc::Status status;
+
+    started_ = write_pending_ = writes_done_ = failed_ = false;
+    resend_next_ = 0;
+    rw->StartCall(tag(Op::Start));
+    pending_ = 1;
+
+    while (pending_ > 0) {
+      bool resend = resend_next_ < in_flight_.size();
+      bool window_open =
+          resend || in_flight_.size() < window_ || queue.is_shutdown();
+      bool can_write = started_ && !write_pending_ && !writes_done_ &&
+                       !failed_ && window_open;
+
+      if (can_write) {
+        drain_events(cq, *rw, status, kNoWait);
+        if (resend_next_ < in_flight_.size()) {
+          // Unacked packets from a broken stream go first, in order.
+          InFlight &entry = in_flight_[resend_next_++];
+          write_started_ = std::chrono::steady_clock::now();
+          entry.sent_us = CaptureClock::local().now();
+          write_is_resend_ = true;
+          rw->Write(entry.bytes, write_options(queue), tag(Op::Write));
+          write_pending_ = true;
+          pending_++;
+        } else if (auto packet = queue.pop_for(kPollInterval)) {
+          record_queue_dwell((*packet)->capture_monotonic());
+          write_started_ = std::chrono::steady_clock::now();
+          int64_t capture_us = (*packet)->capture_monotonic();
+          in_flight_.push_back({capture_us, CaptureClock::local().now(),
+                                to_byte_buffer(std::move(*packet))});
+          resend_next_ = in_flight_.size();
+          publish_outstanding();
+          write_is_resend_ = false;
+          rw->Write(in_flight_.back().bytes, write_options(queue),
+                    tag(Op::Write));
+          write_pending_ = true;
+          pending_++;
+        } else if (queue.closed()) {
+          rw->WritesDone(tag(Op::WritesDone));
+          writes_done_ = true;
+          pending_++;
+        }
+        continue;
+      }
+
+      drain_events(cq, *rw, status,
+                   std::chrono::system_clock::now() + kPollInterval);
+    }
+
+    cq.Shutdown();
+    void *ignored_tag;
+    bool ignored_ok;
+    while (cq.Next(&ignored_tag, &ignored_ok)) {
+    }
+
+    auto line = log_info("Network", "Stream closed");
+    line.field("acked", acked_.load()).field("sent", sent_.load());
+    if (!status.ok())
+      line.field("status", status.error_message());
+    return writes_done_ && !failed_ && status.ok();
+  }
+
+  // While the next write can follow at once, tell gRPC it may hold this one
+  // back and coalesce it with the next. The last write of a burst, or the one
+  // that fills the window, is unhinted and flushes the lot; a held write
+  // would otherwise wait for an ack that cannot come.
+  grpc::WriteOptions write_options(const PacketQueue &queue) const {
+    grpc::WriteOptions options;
+    bool room = in_flight_.size() < window_ || queue.is_shutdown();
+    if (resend_next_ < in_flight_.size() || (room && queue.size() > 0))
+      options.set_buffer_hint();
+    return options;
+  }
+
+  // Handles completion events until the queue is idle past `deadline`
+  // (gRPC deadlines are system_clock based). Once one event is handled, the
+  // rest are polled with kNoWait.
+  void drain_events(grpc::CompletionQueue &cq, Stream &rw,
+                    grpc::Status &status,
+                    std::chrono::system_clock::time_point deadline) {
+    void *got;
+    bool ok;
+    while (pending_ > 0 &&
+           cq.AsyncNext(&got, &ok, deadline) ==
+               grpc::CompletionQueue::GOT_EVENT) {
+      pending_--;
+      handle(static_cast<Op>(reinterpret_cast<intptr_t>(got)), ok, rw,
+             status);
+      deadline = kNoWait;
+    }
+  }
+
+  void handle(Op op, bool ok, Stream &rw, grpc::Status &status) {
+    switch (op) {
+    case Op::Start:
+      if (!ok) {
+        fail(rw, status);
+        break;
+      }
+      started_ = true;
+      rw.Read(&ack_, tag(Op::Read));
+      pending_++;
+      break;
+
+    case Op::Write:
+      write_pending_ = false;
+      if (!ok) {
+        fail(rw, status);
+        break;
+      }
+      Metrics::record(Stage::Write,
+                      std::chrono::steady_clock::now() - write_started_);
+      if (write_is_resend_) {
+        resent_++;
+      } else {
+        sent_++;
+        log_progress();
+      }
+      break;
+
+    case Op::Read:
+      if (!ok) {
+        // The server closed its side. After WritesDone that is the normal
+        // end and Finish is already on its way; before it, the stream failed
+        // (with the window full nothing else would notice).
+        if (!writes_done_)
+          fail(rw, status);
+        break;
+      }
+      on_ack();
+      rw.Read(&ack_, tag(Op::Read));
+      pending_++;
+      break;
+
+    case Op::WritesDone:
+      rw.Finish(&status, tag(Op::Finish));
+      pending_++;
+      break;
+
+    case Op::Finish:
+      break;
+    }
+  }
+
+  void fail(Stream &rw, grpc::Status &status) {
+    if (failed_)
+      return;
+    failed_ = true;
+    log_warn("Network", "Stream failed, finishing");
+    rw.Finish(&status, tag(Op::Finish));
+    pending_++;
+  }
+
+  void on_ack() {
+    if (in_flight_.empty())
+      return; // Unsolicited ack; nothing to match.
+
+    const InFlight &oldest = in_flight_.front();
+    const int64_t now = CaptureClock::local().now();
+    const int64_t received = ack_.received_timestamp();
+    Metrics::record(Stage::AckRtt,
+                    std::chrono::microseconds(now - oldest.sent_us));
+    rtt_us_total_ += now - oldest.sent_us;
+    offset_.add(oldest.sent_us, received, now);
+    if (offset_.valid()) {
+      int64_t latency = received - offset_.to_server(oldest.capture_us);
+      Metrics::record(Stage::OneWay, std::chrono::microseconds(latency));
+      latency_us_total_ += latency;
+      latency_samples_++;
+    }
+    in_flight_.pop_front();
+    publish_outstanding();
+    if (resend_next_ > 0)
+      resend_next_--;
+    conn_->stream_healthy();
+
+    acked_++;
+    if (!ack_.success())
+      nacked_++;
+  }
+
+  void publish_outstanding() {
+    if (link_)
+      link_->outstanding.store(in_flight_.size(), std::memory_order_relaxed);
+  }
+
+  void log_progress() {
+    if (sent_ % 60 != 0)
+      return;
+    auto line = log_info("Network", "Progress", &progress_limit_);
+    line.field("sent", sent_.load())
+        .field("acked", acked_.load())
+        .field("in_flight", in_flight_.size());
+    if (latency_samples_ > 0)
+      line.field("latency_us", latency_us_total_ / int64_t(latency_samples_))
+          .field("latency_error_us", offset_.error_bound());
+    if (acked_ > 0)
+      line.field("rtt_us", rtt_us_total_ / int64_t(acked_.load()));
+    if (nacked_ > 0)
+      line.field("nacked", nacked_);
+  }
+
+  std::string address_;
+  size_t window_;
+  ChannelConfig config_;
+  BackoffPolicy backoff_;
+  std::unique_ptr<ConnectionManager> conn_;
+  std::unique_ptr<RawTelemetryStub> stub_;
+  std::atomic<uint64_t> sent_;
+  std::atomic<uint64_t> acked_;
+
+  // Owned by the streaming thread.
+  ServerAck ack_;
+  std::chrono::steady_clock::time_point write_started_;
+  std::deque<InFlight> in_flight_;
+  size_t resend_next_ = 0; // in_flight_[0, resend_next_) sent on this stream
+  bool write_is_resend_ = false;
+  uint64_t resent_ = 0;
+  int pending_ = 0;
+  bool started_ = false;
+  bool write_pending_ = false;
+  bool writes_done_ = false;
+  bool failed_ = false;
+  uint64_t nacked_ = 0;
+  ClockOffsetEstimator offset_;
+  DrainCancel *cancel_ = nullptr;
+  LinkState *link_ = nullptr;
+  uint64_t lost_ = 0;
+  LogRateLimit progress_limit_{Logger::instance().default_rate()};
+  int64_t latency_us_total_ = 0;
+  uint64_t latency_samples_ = 0;
+  int64_t rtt_us_total_ = 0;
+};
+
+} // namespace omnistream
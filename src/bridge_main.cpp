@@ -0,0 +1,169 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "aggregation_engine.hpp"
+#include "cli_args.hpp"
+#include "dashboard_fanout.hpp"
+#include "frame_scheduler.hpp"
+#include "ingest_service.hpp"
+#include "shutdown.hpp"
+#include "websocket_server.hpp"
+#include <grpcpp/grpcpp.h>
+
+using namespace omnistream;
+
+// Dashboard bridge: agents stream to this process over gRPC, and browsers
+// receive the latest state of each vehicle over WebSocket at a fixed rate.
+
+std::atomic<bool> running{true};
+
+struct BridgeOptions {
+  std::string listen = "0.0.0.0:50051";
+  uint16_t ws_port = 8765;
+  double rate_hz = 60.0;
+  size_t client_backlog_kb = 4096;
+  double summary_hz = 1.0;
+  AggregationConfig aggregation;
+};
+
+// Publishes a frame to the dashboard clients on a fixed schedule. Vehicles
+// that sent nothing new since a client's last frame are not re-sent.
+void broadcast_thread(VehicleStore &store, WebSocketServer &ws,
+                      DashboardFanout &fanout, const IngestService &ingest,
+                      const BridgeOptions &opts) {
+  FrameScheduler scheduler(opts.rate_hz);
+  uint64_t last_packets = 0;
+  auto last_log = std::chrono::steady_clock::now();
+
+  while (running) {
+    fanout.publish(scheduler.frames());
+
+    auto now = std::chrono::steady_clock::now();
+    if (now - last_log >= std::chrono::seconds(1)) {
+      uint64_t packets = ingest.packets();
+      std::cout << "[Bridge] Frame " << scheduler.frames() << " | Streams "
+                << ingest.streams() << " | Vehicles " << store.size()
+                << " | Ingest " << packets - last_packets << " pkt/s"
+                << " | Clients " << ws.clients() << " | Sent "
+                << fanout.messages() << " (" << fanout.encodes()
+                << " encoded, " << fanout.summaries() << " summaries)"
+                << " | Dropped " << ws.dropped() << std::endl;
+      last_packets = packets;
+      last_log = now;
+    }
+    scheduler.wait();
+  }
+}
+
+void print_usage(std::ostream &out) {
+  out << "Usage: omnistream_bridge [--listen ADDR] [--ws-port PORT]\n"
+      << "                         [--rate HZ]"
+         " [--client-backlog-kb KB]\n"
+      << "                         [--summary-rate HZ]"
+         " [--sectors N] [--percentile P]\n"
+      << "                         [--imu-window N]"
+         " [--lidar-window N]\n";
+}
+
+int main(int argc, char *argv[]) {
+  std::cout << "========================================\n"
+            << "  OmniStream Dashboard Bridge v1.0\n"
+            << "  gRPC ingest | WebSocket fan-out\n"
+            << "========================================\n";
+
+  BridgeOptions opts;
+  const FlagValues value(print_usage);
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--listen" && i + 1 < argc)
+      opts.listen = argv[++i];
+    else if (arg == "--ws-port" && i + 1 < argc)
+      opts.ws_port = static_cast<uint16_t>(
+          std::min<size_t>(value.count(arg, argv[++i]), UINT16_MAX));
+    else if (arg == "--rate" && i + 1 < argc)
+      opts.rate_hz = std::max(1.0, value.real(arg, argv[++i]));
+    else if (arg == "--client-backlog-kb" && i + 1 < argc)
+      opts.client_backlog_kb =
+          std::max<size_t>(64, value.count(arg, argv[++i]));
+    else if (arg == "--summary-rate" && i + 1 < argc)
+      opts.summary_hz = std::max(0.01, value.real(arg, argv[++i]));
+    else if (arg == "--imu-window" && i + 1 < argc)
+      opts.aggregation.imu_window =
+          std::max<size_t>(2, value.count(arg, argv[++i]));
+    else if (arg == "--lidar-window" && i + 1 < argc)
+      opts.aggregation.lidar_window =
+          std::max<size_t>(1, value.count(arg, argv[++i]));
+    else if (arg == "--sectors" && i + 1 < argc)
+      opts.aggregation.sectors =
+          std::clamp<size_t>(value.count(arg, argv[++i]), 1, 360);
+    else if (arg == "--percentile" && i + 1 < argc)
+      opts.aggregation.percentile =
+          std::clamp(
+          static_cast<float>(value.real(arg, argv[++i]) / 100.0), 0.0f, 1.0f);
+    else if (arg == "--help") {
+      print_usage(std::cout);
+      return 0;
+    }
+  }
+
+  std::cout << "Ingest:    " << opts.listen << " (gRPC)\n"
+            << "WebSocket: ws://0.0.0.0:" << opts.ws_port << "\n"
+            << "Rate:      " << opts.rate_hz << " Hz\n"
+            << "Backlog:   " << opts.client_backlog_kb << " KB per client\n"
+            << "Summary:   " << opts.summary_hz << " Hz, "
+            << opts.aggregation.imu_window << " IMU samples, "
+            << opts.aggregation.lidar_window << " scans, "
+            << opts.aggregation.sectors << " sectors, p"
+            << opts.aggregation.percentile * 100 << "\n\n";
+
+  // Before any thread starts, so all of them inherit the blocked signals.
+  StopSignal stop;
+
+  VehicleStore store;
+  AggregationEngine aggregator(opts.aggregation);
+  IngestService ingest(store, &aggregator);
+  WebSocketServer ws(opts.ws_port, opts.client_backlog_kb << 10);
+  DashboardFanout fanout(store, ws, opts.rate_hz, &aggregator,
+                         opts.summary_hz);
+  ws.set_handlers(fanout.handlers());
+  if (!ws.start())
+    return 1;
+
+  grpc::ServerBuilder builder;
+  builder.AddListeningPort(opts.listen, grpc::InsecureServerCredentials());
+  builder.RegisterService(&ingest);
+  auto server = builder.BuildAndStart();
+  if (!server) {
+    std::cerr << "[Ingest] Cannot listen on " << opts.listen << std::endl;
+    return 1;
+  }
+  std::cout << "[Ingest] Listening on " << opts.listen << std::endl;
+
+  std::thread broadcaster(broadcast_thread, std::ref(store), std::ref(ws),
+                          std::ref(fanout), std::cref(ingest),
+                          std::cref(opts));
+
+  while (stop.wait() != StopSignal::Event::Signal) {
+  }
+  std::cout << "\nShutting down (" << strsignal(stop.last_signal()) << ")..."
+            << std::endl;
+  running = false;
+
+  // Give agents a moment to finish their streams, then cancel the rest.
+  server->Shutdown(std::chrono::system_clock::now() +
+                   std::chrono::seconds(1));
+  broadcaster.join();
+  ws.stop();
+
+  std::cout << "[Bridge] Ingested " << ingest.packets() << " packets ("
+            << ingest.undecodable() << " LiDAR frames awaiting keyframe)\n"
+            << "OmniStream bridge stopped.\n";
+  return 0;
+}
@@ -0,0 +1,232 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define OMNISTREAM_HAVE_TSC 1
+#endif
+
+namespace omnistream {
+
+// Microseconds on the steady_clock (CLOCK_MONOTONIC) timeline.
+inline int64_t steady_micros() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+enum class ClockSource { Steady, Tsc };
+
+// Capture timestamps for packets: monotonic microseconds on the
+// steady_clock timeline, plus the current wall - monotonic offset so
+// receivers can still show wall time. Packets carry both, so an NTP step
+// moves the offset but never the monotonic times latency is computed from.
+//
+// With ClockSource::Tsc (x86 with an invariant TSC), now() is one rdtsc
+// and a multiply-add instead of a clock_gettime call. The TSC rate is
+// calibrated against steady_clock at startup and refined every second over
+// the whole run, so the two timelines agree to well under a microsecond.
+// Each thread has its own instance (local()); now() never goes backwards.
+class CaptureClock {
+public:
+  static constexpr int64_t kRefreshUs = 1000000;
+
+  // Selects the source for every thread. Call before threads start.
+  // Returns false, keeping steady_clock, if the TSC is not invariant.
+  static bool use(ClockSource source) {
+    if (source == ClockSource::Tsc && !tsc_invariant())
+      return false;
+    if (source == ClockSource::Tsc)
+      calibrate();
+    source_ = source;
+    return true;
+  }
+
+  static ClockSource source() { return source_; }
+  static const char *source_name() {
+    return source_ == ClockSource::Tsc ? "tsc" : "steady_clock";
+  }
+
+  static CaptureClock &local() {
+    thread_local CaptureClock clock;
+    return clock;
+  }
+
+  // Monotonic capture time in microseconds.
+  int64_t now() {
+    int64_t us = read();
+    if (us >= next_refresh_) {
+      refresh();
+      us = read();
+    }
+    last_ = std::max(last_, us);
+    return last_;
+  }
+
+  // Wall clock minus monotonic time, in microseconds, as of the last
+  // refresh (at most kRefreshUs ago).
+  int64_t wall_offset() {
+    if (next_refresh_ == std::numeric_limits<int64_t>::min())
+      refresh();
+    return wall_offset_;
+  }
+
+private:
+  CaptureClock() = default;
+
+  int64_t read() const {
+#if OMNISTREAM_HAVE_TSC
+    if (source_ == ClockSource::Tsc)
+      return anchor_us_ + static_cast<int64_t>(
+                              static_cast<double>(__rdtsc() - anchor_tsc_) *
+                              us_per_tick_);
+#endif
+    return steady_micros();
+  }
+
+  // Re-samples the wall offset and, for the TSC, re-anchors it to
+  // steady_clock with the rate measured since this thread's first anchor.
+  void refresh() {
+    wall_offset_ = sample_wall_offset();
+#if OMNISTREAM_HAVE_TSC
+    if (source_ == ClockSource::Tsc) {
+      uint64_t tsc = 0;
+      int64_t us = paired_read(&tsc);
+      if (first_tsc_ == 0) {
+        first_tsc_ = tsc;
+        first_us_ = us;
+        us_per_tick_ = calibrated_us_per_tick_.load();
+      } else if (tsc > first_tsc_ && us > first_us_) {
+        us_per_tick_ = static_cast<double>(us - first_us_) /
+                       static_cast<double>(tsc - first_tsc_);
+      }
+      anchor_tsc_ = tsc;
+      anchor_us_ = us;
+    }
+#endif
+    next_refresh_ = read() + kRefreshUs;
+  }
+
+  // Wall minus steady time from the tightest of a few bracketed reads.
+  static int64_t sample_wall_offset() {
+    int64_t best_gap = std::numeric_limits<int64_t>::max(), offset = 0;
+    for (int i = 0; i < 3; ++i) {
+      auto before = std::chrono::steady_clock::now();
+      auto wall = std::chrono::system_clock::now();
+      auto after = std::chrono::steady_clock::now();
+      int64_t gap = (after - before).count();
+      if (gap < best_gap) {
+        best_gap = gap;
+        auto mid = before + (after - before) / 2;
+        offset = std::chrono::duration_cast<std::chrono::microseconds>(
+                     wall.time_since_epoch() - mid.time_since_epoch())
+                     .count();
+      }
+    }
+    return offset;
+  }
+
+#if OMNISTREAM_HAVE_TSC
+  // steady_clock time bracketed by two TSC reads; *tsc is their midpoint.
+  static int64_t paired_read(uint64_t *tsc) {
+    uint64_t before = __rdtsc();
+    int64_t us = steady_micros();
+    uint64_t after = __rdtsc();
+    *tsc = before + (after - before) / 2;
+    return us;
+  }
+
+  // Initial TSC rate over 20 ms; each thread then refines its own.
+  static void calibrate() {
+    uint64_t t0 = 0, t1 = 0;
+    int64_t us0 = paired_read(&t0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    int64_t us1 = paired_read(&t1);
+    calibrated_us_per_tick_ =
+        static_cast<double>(us1 - us0) / static_cast<double>(t1 - t0);
+  }
+
+  static bool tsc_invariant() {
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::string line;
+    while (std::getline(cpuinfo, line))
+      if (line.rfind("flags", 0) == 0)
+        return line.find(" constant_tsc") != std::string::npos &&
+               line.find(" nonstop_tsc") != std::string::npos;
+    return false;
+  }
+#else
+  static void calibrate() {}
+  static bool tsc_invariant() { return false; }
+#endif
+
+  static inline ClockSource source_ = ClockSource::Steady;
+  static inline std::atomic<double> calibrated_us_per_tick_{0.0};
+
+  int64_t next_refresh_ = std::numeric_limits<int64_t>::min();
+  int64_t last_ = std::numeric_limits<int64_t>::min();
+  int64_t wall_offset_ = 0;
+  uint64_t anchor_tsc_ = 0, first_tsc_ = 0;
+  int64_t anchor_us_ = 0, first_us_ = 0;
+  double us_per_tick_ = 0.0;
+};
+
+// Offset between a server's wall clock and this agent's monotonic clock,
+// estimated from acks. Each ack gives the send time t1 and ack arrival t4
+// on our clock and the server's receive time t2 on its clock; with the ack
+// written right after the read, offset = t2 - (t1 + t4) / 2 to within half
+// the round trip. Samples with the smallest round trip are the least
+// queued, so the estimate is the lowest-RTT sample of the previous epoch,
+// replaced as soon as the current epoch has found a tighter one. Epochs
+// are short enough that clock drift between them is negligible.
+class ClockOffsetEstimator {
+public:
+  static constexpr int64_t kEpochUs = 5000000;
+
+  void add(int64_t sent_us, int64_t server_us, int64_t acked_us) {
+    int64_t rtt = acked_us - sent_us;
+    if (rtt < 0)
+      return;
+    int64_t offset = server_us - (sent_us + acked_us) / 2;
+    if (rtt < current_.rtt)
+      current_ = {rtt, offset};
+    if (current_.rtt <= best_.rtt || acked_us - epoch_start_ >= kEpochUs) {
+      best_ = current_;
+      if (acked_us - epoch_start_ >= kEpochUs) {
+        current_ = Sample{};
+        epoch_start_ = acked_us;
+      }
+    }
+    samples_++;
+  }
+
+  bool valid() const { return best_.rtt != Sample{}.rtt; }
+  // Server time minus our monotonic time, in microseconds.
+  int64_t offset() const { return best_.offset; }
+  // Worst-case error of offset(): half the round trip it came from.
+  int64_t error_bound() const { return best_.rtt / 2; }
+  uint64_t samples() const { return samples_; }
+
+  // Our monotonic time `local_us` on the server's clock.
+  int64_t to_server(int64_t local_us) const { return local_us + offset(); }
+
+private:
+  struct Sample {
+    int64_t rtt = std::numeric_limits<int64_t>::max();
+    int64_t offset = 0;
+  };
+
+  Sample current_, best_;
+  int64_t epoch_start_ = 0;
+  uint64_t samples_ = 0;
+};
+
+} // namespace omnistream
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstdlib>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <grpcpp/grpcpp.h>
+
+namespace omnistream {
+
+// gRPC channel and stream tuning for the live clients. Zero means "gRPC
+// default" for every numeric field. Compression is set per stream: the
+// client compresses every message it sends with the chosen algorithm and
+// advertises it in grpc-encoding. gzip and deflate are built into every gRPC
+// server, so no server change is needed.
+struct ChannelConfig {
+  grpc_compression_algorithm compression = GRPC_COMPRESS_NONE;
+  int keepalive_ms = 0;         // Ping interval on idle connections
+  int keepalive_timeout_ms = 0; // Ping ack deadline before the link is dead
+  int max_message_mb = 0;       // Send and receive limit
+  int http2_window_kb = 0;      // Per-stream flow-control lookahead
+  int write_buffer_kb = 0;      // Transport write buffer per stream
+  // Extra --channel-arg KEY=VALUE pairs; integer values are set as ints.
+  std::vector<std::pair<std::string, std::string>> extra;
+  // gRPC shares a subchannel, and so one TCP connection, between channels
+  // to the same target with equal arguments. A distinct id plus a local
+  // subchannel pool gives every channel a connection of its own.
+  int channel_id = -1;
+
+  // This config for the `id`-th of the process's channels.
+  ChannelConfig for_channel(int id) const {
+    ChannelConfig config = *this;
+    config.channel_id = id;
+    return config;
+  }
+
+  grpc::ChannelArguments channel_args() const {
+    grpc::ChannelArguments args;
+    if (channel_id >= 0) {
+      args.SetInt("omnistream.channel_id", channel_id);
+      args.SetInt(GRPC_ARG_USE_LOCAL_SUBCHANNEL_POOL, 1);
+    }
+    if (keepalive_ms > 0) {
+      args.SetInt(GRPC_ARG_KEEPALIVE_TIME_MS, keepalive_ms);
+      args.SetInt(GRPC_ARG_KEEPALIVE_PERMIT_WITHOUT_CALLS, 1);
+      args.SetInt(GRPC_ARG_HTTP2_MAX_PINGS_WITHOUT_DATA, 0);
+    }
+    if (keepalive_timeout_ms > 0)
+      args.SetInt(GRPC_ARG_KEEPALIVE_TIMEOUT_MS, keepalive_timeout_ms);
+    if (max_message_mb > 0) {
+      args.SetMaxSendMessageSize(max_message_mb << 20);
+      args.SetMaxReceiveMessageSize(max_message_mb << 20);
+    }
+    if (http2_window_kb > 0)
+      args.SetInt(GRPC_ARG_HTTP2_STREAM_LOOKAHEAD_BYTES, http2_window_kb << 10);
+    if (write_buffer_kb > 0)
+      args.SetInt(GRPC_ARG_HTTP2_WRITE_BUFFER_SIZE, write_buffer_kb << 10);
+    for (const auto &[key, value] : extra) {
+      char *end = nullptr;
+      long n = std::strtol(value.c_str(), &end, 10);
+      if (!value.empty() && *end == '\0')
+        args.SetInt(key, static_cast<int>(n));
+      else
+        args.SetString(key, value);
+    }
+    return args;
+  }
+
+  // Per-stream settings; call on each ClientContext before starting the RPC.
+  void apply(grpc::ClientContext &ctx) const {
+    if (compression != GRPC_COMPRESS_NONE)
+      ctx.set_compression_algorithm(compression);
+  }
+
+  // Parses none|gzip|deflate; returns false for anything else.
+  bool set_compression(const std::string &name) {
+    if (name == "none")
+      compression = GRPC_COMPRESS_NONE;
+    else if (name == "gzip")
+      compression = GRPC_COMPRESS_GZIP;
+    else if (name == "deflate")
+      compression = GRPC_COMPRESS_DEFLATE;
+    else
+      return false;
+    return true;
+  }
+
+  const char *compression_name() const {
+    switch (compression) {
+    case GRPC_COMPRESS_GZIP:
+      return "gzip";
+    case GRPC_COMPRESS_DEFLATE:
+      return "deflate";
+    default:
+      return "none";
+    }
+  }
+
+  // Adds a KEY=VALUE channel argument; returns false if there is no '='.
+  bool add_arg(const std::string &kv) {
+    auto eq = kv.find('=');
+    if (eq == std::string::npos || eq == 0)
+      return false;
+    extra.emplace_back(kv.substr(0, eq), kv.substr(eq + 1));
+    return true;
+  }
+};
+
+} // namespace omnistream
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "connection_manager.hpp"
+#include "logger.hpp"
+#include "packet_queue.hpp"
+#include "shutdown.hpp"
+#include "telemetry.pb.h"
+
+namespace omnistream {
+
+// How a ChannelRouter picks the channel for a packet.
+enum class RoutePolicy {
+  LeastOutstanding, // Fewest packets queued or unacked on the channel
+  VehicleHash,      // Rendezvous hash of vehicle_id; keeps each vehicle's order
+};
+
+// Parses least-outstanding|vehicle-hash; returns false for anything else.
+inline bool parse_route_policy(const std::string &name, RoutePolicy *policy) {
+  if (name == "least-outstanding")
+    *policy = RoutePolicy::LeastOutstanding;
+  else if (name == "vehicle-hash")
+    *policy = RoutePolicy::VehicleHash;
+  else
+    return false;
+  return true;
+}
+
+inline const char *route_policy_name(RoutePolicy policy) {
+  return policy == RoutePolicy::VehicleHash ? "vehicle-hash"
+                                            : "least-outstanding";
+}
+
+// Spreads one pipeline's packets over K channels, each drained by its own
+// client on its own thread and connection. route() runs on the pipeline's
+// network thread: it pops the pipeline queue and pushes every packet onto
+// the queue of the channel the policy picks.
+//
+// LeastOutstanding ranks a channel by its queue plus the packets its client
+// has taken but not had acked (LinkState::outstanding): the async client
+// pops straight into its ack window, so its queue alone reads near zero
+// however far behind the server is.
+//
+// Only channels whose LinkState is up are picked; with every link down, all
+// are eligible and the clients spool or back up as they would alone. With
+// vehicle-hash, a vehicle moves only while its channel is down, so its
+// packets stay in order except around such a move. A full channel queue
+// holds the router (and so the pipeline queue) back until there is room,
+// or until the drain is cancelled, after which packets that do not fit are
+// dropped and counted in lost().
+class ChannelRouter {
+public:
+  static constexpr auto kFullWait = std::chrono::microseconds(100);
+
+  ChannelRouter(size_t channels, size_t capacity, RoutePolicy policy)
+      : policy_(policy) {
+    for (size_t c = 0; c < std::max<size_t>(1, channels); ++c)
+      channels_.push_back(std::make_unique<Channel>(capacity));
+  }
+
+  size_t channels() const { return channels_.size(); }
+  PacketQueue &queue(size_t c) { return channels_[c]->queue; }
+  LinkState *link(size_t c) { return &channels_[c]->link; }
+  uint64_t routed(size_t c) const { return channels_[c]->routed; }
+  uint64_t lost() const { return lost_; }
+
+  // Routes until `in` is closed and drained, then shuts down every channel
+  // queue so its client finishes.
+  void route(PacketQueue &in, const DrainCancel *cancel) {
+    while (auto packet = in.pop()) {
+      Channel *channel = &pick(**packet);
+      while (full(*channel)) {
+        if (cancel && cancel->cancelled()) {
+          channel = nullptr;
+          break;
+        }
+        std::this_thread::sleep_for(kFullWait);
+        channel = &pick(**packet);
+      }
+      if (!channel) {
+        lost_++;
+        continue;
+      }
+      channel->queue.push(std::move(*packet));
+      channel->routed++;
+    }
+    for (auto &channel : channels_)
+      channel->queue.shutdown();
+  }
+
+private:
+  struct Channel {
+    explicit Channel(size_t capacity) : queue(capacity) {}
+    PacketQueue queue;
+    LinkState link;
+    uint64_t routed = 0;
+  };
+
+  // The router is the only producer, so a queue below capacity stays so
+  // until the next push.
+  static bool full(const Channel &channel) {
+    return channel.queue.size() >= channel.queue.capacity();
+  }
+
+  Channel &pick(const TelemetryPacket &packet) {
+    bool any_up = false;
+    for (const auto &channel : channels_)
+      any_up = any_up || channel->link.up.load(std::memory_order_relaxed);
+    auto eligible = [&](const Channel &channel) {
+      return !any_up || channel.link.up.load(std::memory_order_relaxed);
+    };
+
+    const size_t n = channels_.size();
+    Channel *best = nullptr;
+    if (policy_ == RoutePolicy::VehicleHash) {
+      // Highest random weight: the channel with the largest hash of
+      // (vehicle, channel) wins, so removing one only moves its vehicles.
+      uint64_t h = std::hash<std::string_view>{}(packet.vehicle_id());
+      uint64_t best_score = 0;
+      for (size_t c = 0; c < n; ++c) {
+        uint64_t score = mix(h + (c + 1) * 0x9E3779B97F4A7C15ull);
+        if (eligible(*channels_[c]) && (!best || score > best_score)) {
+          best = channels_[c].get();
+          best_score = score;
+        }
+      }
+    } else {
+      // Rotate the starting channel so ties do not all go to channel 0.
+      size_t start = next_++ % n;
+      size_t best_load = 0;
+      for (size_t i = 0; i < n; ++i) {
+        Channel *channel = channels_[(start + i) % n].get();
+        size_t load = outstanding(*channel);
+        if (eligible(*channel) && (!best || load < best_load)) {
+          best = channel;
+          best_load = load;
+        }
+      }
+    }
+    return *best;
+  }
+
+  static size_t outstanding(const Channel &channel) {
+    return channel.queue.size() +
+           channel.link.outstanding.load(std::memory_order_relaxed);
+  }
+
+  // splitmix64 finalizer.
+  static uint64_t mix(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+  }
+
+  RoutePolicy policy_;
+  std::vector<std::unique_ptr<Channel>> channels_;
+  size_t next_ = 0;
+  uint64_t lost_ = 0;
+};
+
+} // namespace omnistream
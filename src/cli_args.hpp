@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cerrno>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+namespace omnistream {
+
+// Checked values for numeric command-line flags. std::stoul and friends
+// throw on text like "abc", which escapes main() into std::terminate; here
+// a bad value names the flag, prints the usage text and exits with status 1.
+class FlagValues {
+public:
+  using Usage = void (*)(std::ostream &);
+
+  explicit FlagValues(Usage usage) : usage_(usage) {}
+
+  // Non-negative integer; a sign is rejected rather than wrapped.
+  size_t count(const std::string &flag, const char *text) const {
+    char *end = nullptr;
+    errno = 0;
+    unsigned long long value = std::strtoull(text, &end, 10);
+    if (!complete(text, end) || std::strchr(text, '-') || errno == ERANGE ||
+        value > SIZE_MAX)
+      fail(flag, text);
+    return static_cast<size_t>(value);
+  }
+
+  int integer(const std::string &flag, const char *text) const {
+    char *end = nullptr;
+    errno = 0;
+    long value = std::strtol(text, &end, 10);
+    if (!complete(text, end) || errno == ERANGE || value < INT_MIN ||
+        value > INT_MAX)
+      fail(flag, text);
+    return static_cast<int>(value);
+  }
+
+  // Finite number; inf and nan are rejected.
+  double real(const std::string &flag, const char *text) const {
+    char *end = nullptr;
+    double value = std::strtod(text, &end);
+    if (!complete(text, end) || !std::isfinite(value))
+      fail(flag, text);
+    return value;
+  }
+
+private:
+  static bool complete(const char *text, const char *end) {
+    return end != text && *end == '\0';
+  }
+
+  [[noreturn]] void fail(const std::string &flag, const char *text) const {
+    std::cerr << "Invalid value '" << text << "' for " << flag << "\n";
+    usage_(std::cerr);
+    std::exit(1);
+  }
+
+  Usage usage_;
+};
+
+} // namespace omnistream
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+
+#include "channel_config.hpp"
+#include "logger.hpp"
+#include <grpcpp/grpcpp.h>
+
+namespace omnistream {
+
+// Exponential backoff between reconnect attempts. Each delay is drawn
+// uniformly from +-jitter around the nominal one, so a fleet that lost the
+// same server does not reconnect in lockstep.
+struct BackoffPolicy {
+  std::chrono::milliseconds initial{100};
+  std::chrono::milliseconds max{5000};
+  double multiplier = 2.0;
+  double jitter = 0.2;
+};
+
+class ReconnectBackoff {
+public:
+  explicit ReconnectBackoff(BackoffPolicy policy = {})
+      : policy_(policy), rng_(std::random_device{}()),
+        nominal_(policy.initial.count()) {}
+
+  std::chrono::milliseconds next() {
+    std::uniform_real_distribution<double> spread(1.0 - policy_.jitter,
+                                                  1.0 + policy_.jitter);
+    double delay = nominal_ * spread(rng_);
+    nominal_ = std::min<double>(nominal_ * policy_.multiplier,
+                                policy_.max.count());
+    attempts_++;
+    return std::chrono::milliseconds(static_cast<int64_t>(delay));
+  }
+
+  void reset() {
+    nominal_ = policy_.initial.count();
+    attempts_ = 0;
+  }
+
+  uint32_t attempts() const { return attempts_; }
+
+private:
+  BackoffPolicy policy_;
+  std::mt19937 rng_;
+  double nominal_;
+  uint32_t attempts_ = 0;
+};
+
+// Link health a ConnectionManager publishes for other threads, e.g. a
+// ChannelRouter picking a channel.
+struct LinkState {
+  std::atomic<bool> up{false};
+  std::atomic<uint64_t> failures{0};
+  // Published by the client, not the ConnectionManager: packets taken from
+  // its queue on the current stream and not yet acked.
+  std::atomic<size_t> outstanding{0};
+};
+
+// Owns one pipeline's channel and decides when a broken stream may be
+// reopened. gRPC's own transport reconnects use the same backoff bounds;
+// on top of that, reopening a stream waits a jittered delay and then for the
+// channel to report READY. Waits poll `stop` at least every kPoll so callers
+// can give up on shutdown or keep spooling packets while the link is down.
+class ConnectionManager {
+public:
+  static constexpr auto kPoll = std::chrono::milliseconds(100);
+
+  ConnectionManager(const std::string &address, const ChannelConfig &config,
+                    BackoffPolicy policy = {})
+      : address_(address), backoff_(policy) {
+    grpc::ChannelArguments args = config.channel_args();
+    // gRPC's default backoff grows to two minutes; keep transport attempts
+    // on our schedule. The minimum doubles as the connect timeout.
+    args.SetInt(GRPC_ARG_INITIAL_RECONNECT_BACKOFF_MS,
+                static_cast<int>(policy.initial.count()));
+    args.SetInt(GRPC_ARG_MIN_RECONNECT_BACKOFF_MS,
+                static_cast<int>(
+                    std::max<int64_t>(1000, policy.initial.count())));
+    args.SetInt(GRPC_ARG_MAX_RECONNECT_BACKOFF_MS,
+                static_cast<int>(policy.max.count()));
+    channel_ = grpc::CreateCustomChannel(
+        address_, grpc::InsecureChannelCredentials(), args);
+  }
+
+  std::shared_ptr<grpc::Channel> channel() const { return channel_; }
+
+  // Publishes health to `link` (may be null) as streams fail and recover.
+  void set_link_state(LinkState *link) { link_ = link; }
+
+  // Waits up to `timeout` for the first connection.
+  bool connect(std::chrono::milliseconds timeout) {
+    bool ready =
+        channel_->WaitForConnected(std::chrono::system_clock::now() + timeout);
+    if (link_)
+      link_->up = ready;
+    return ready;
+  }
+
+  // Call when a stream breaks. Starts the outage clock on the first failure.
+  void stream_failed() {
+    if (link_) {
+      link_->up = false;
+      link_->failures++;
+    }
+    if (!down_) {
+      down_ = true;
+      down_since_ = std::chrono::steady_clock::now();
+      log_warn("Network") << "Link down, reconnecting to " << address_;
+    }
+  }
+
+  // Call once a reopened stream delivers data; ends the outage.
+  void stream_healthy() {
+    if (link_ && !link_->up.load(std::memory_order_relaxed))
+      link_->up = true;
+    if (!down_)
+      return;
+    auto outage = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - down_since_);
+    log_info("Network", "Reconnected")
+        .field("outage_ms", outage.count())
+        .field("attempts", backoff_.attempts());
+    down_ = false;
+    reconnects_++;
+    backoff_.reset();
+  }
+
+  // Sleeps the next backoff delay, then waits for the channel to be READY.
+  // Returns false if `stop()` returned true first.
+  template <typename Stop> bool await_retry(Stop stop) {
+    auto retry_at = std::chrono::steady_clock::now() + backoff_.next();
+    while (true) {
+      auto state = channel_->GetState(true);
+      auto now = std::chrono::steady_clock::now();
+      if (now >= retry_at && state == GRPC_CHANNEL_READY)
+        return true;
+      if (stop())
+        return false;
+      if (state == GRPC_CHANNEL_READY) {
+        std::this_thread::sleep_for(
+            std::min<std::chrono::steady_clock::duration>(kPoll,
+                                                          retry_at - now));
+      } else {
+        channel_->WaitForStateChange(state,
+                                     std::chrono::system_clock::now() + kPoll);
+      }
+    }
+  }
+
+  bool down() const { return down_; }
+  uint64_t reconnects() const { return reconnects_; }
+
+private:
+  std::string address_;
+  std::shared_ptr<grpc::Channel> channel_;
+  ReconnectBackoff backoff_;
+  bool down_ = false;
+  LinkState *link_ = nullptr;
+  std::chrono::steady_clock::time_point down_since_;
+  uint64_t reconnects_ = 0;
+};
+
+} // namespace omnistream
@@ -0,0 +1,268 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "aggregation_engine.hpp"
+#include "dashboard_protocol.hpp"
+#include "ingest_service.hpp"
+#include "websocket_server.hpp"
+
+namespace omnistream {
+
+// Per-client delivery on top of the VehicleStore. Clients with the same
+// Subscription form one group; each due group gets every wanted vehicle
+// updated since its own last send. A group at rate_hz runs on every
+// round(bridge_rate / rate_hz)-th frame. Per frame, a vehicle's scan is cut
+// down once per distinct LidarView and encoded once per (view, format), no
+// matter how many groups or clients share it.
+//
+// Groups subscribed to the "summary" format get no raw frames; given an
+// AggregationEngine, they receive its rolling summaries at summary_hz
+// instead, encoded once per distinct vehicle filter.
+//
+// New clients get full-resolution JSON at the full rate, as before; app.js
+// subscribes with {"type":"subscribe","format":"q16","rate":20,...}.
+class DashboardFanout {
+public:
+  using ClientId = WebSocketServer::ClientId;
+
+  DashboardFanout(VehicleStore &store, WebSocketServer &ws, double rate_hz,
+                  const AggregationEngine *aggregator = nullptr,
+                  double summary_hz = 1.0)
+      : store_(store), ws_(ws), rate_hz_(rate_hz), aggregator_(aggregator),
+        summary_hz_(std::min(summary_hz, rate_hz)),
+        summary_divisor_(std::max<uint64_t>(
+            1, std::llround(rate_hz / std::max(summary_hz, 1e-3)))) {}
+
+  WebSocketServer::Handlers handlers() {
+    return {[this](ClientId id) { return on_open(id); },
+            [this](ClientId id, std::string_view text) {
+              on_message(id, text);
+            },
+            [this](ClientId id) { on_close(id); }};
+  }
+
+  // Sends what is due this frame. Call once per bridge frame, always from
+  // the same thread.
+  void publish(uint64_t frame) {
+    const bool summaries = frame % summary_divisor_ == 0;
+    // Both locks are held only for copies: the due groups under mutex_, so
+    // the I/O thread's open, subscribe and close are not held up by
+    // encoding, and the changed vehicles under the store lock.
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      due_.clear();
+      for (const auto &[sub, group] : groups_) {
+        bool summary = sub.format == WireFormat::Summary;
+        if (summary ? summaries : frame % group.divisor == 0)
+          due_.push_back({sub, group.clients, group.id});
+      }
+      for (uint64_t id : closed_)
+        seen_.erase(id);
+      closed_.clear();
+    }
+    if (summaries)
+      publish_summaries();
+    store_.copy_updated(&vehicles_);
+    for (const Due &group : due_) {
+      const Subscription &sub = group.sub;
+      if (sub.format == WireFormat::Summary)
+        continue;
+      // Each group sends every vehicle updated since its own last send, in
+      // vehicle id order.
+      SeenTicks &seen = seen_[group.id];
+      for (const auto &[id, v] : vehicles_) {
+        uint64_t &last = seen[id];
+        if (v.tick == last)
+          continue;
+        last = v.tick;
+        if (!sub.wants(id))
+          continue;
+        ws_.send(group.clients, encode(v, sub.view, sub.format));
+        messages_ += group.clients.size();
+      }
+    }
+    views_.clear();
+    frames_.clear();
+  }
+
+  uint64_t messages() const { return messages_; }
+  uint64_t summaries() const { return summaries_; }
+  uint64_t encodes() const { return encodes_; }
+
+private:
+  struct Group {
+    std::vector<ClientId> clients;
+    uint64_t divisor = 1;
+    uint64_t id = 0; // Keys seen_; a group made again starts afresh
+  };
+
+  // A group due this frame, as copied out of groups_.
+  struct Due {
+    Subscription sub;
+    std::vector<ClientId> clients;
+    uint64_t id;
+  };
+
+  // Per-frame caches, keyed by vehicle id. Entries carry the tick they were
+  // made from.
+  struct CachedScan {
+    uint64_t tick = 0;
+    ScanView scan;
+  };
+
+  struct CachedFrame {
+    uint64_t tick = 0;
+    WebSocketServer::Frame frame;
+  };
+
+  using FrameKey = std::pair<LidarView, WireFormat>;
+
+  // Sends the current summaries to every summary group.
+  void publish_summaries() {
+    if (!aggregator_)
+      return;
+    std::vector<VehicleSummary> fleet;
+    std::map<std::vector<std::string>, WebSocketServer::Frame> encoded;
+    for (const Due &group : due_) {
+      const Subscription &sub = group.sub;
+      if (sub.format != WireFormat::Summary)
+        continue;
+      if (fleet.empty())
+        fleet = aggregator_->summaries();
+      auto it = encoded.find(sub.vehicles);
+      if (it == encoded.end())
+        it = encoded
+                 .emplace(sub.vehicles,
+                          WebSocketServer::make_frame(
+                              ws::kText,
+                              summary_json_.encode(
+                                  fleet, aggregator_->config(), sub)))
+                 .first;
+      ws_.send(group.clients, it->second);
+      summaries_ += group.clients.size();
+    }
+  }
+
+  std::string on_open(ClientId id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    join(id, Subscription{});
+    return R"({"type":"connected","mode":"grpc",)"
+           R"("formats":["json","f32","q16","summary"],"rate":)" +
+           std::to_string(static_cast<int>(rate_hz_)) + "}";
+  }
+
+  void on_message(ClientId id, std::string_view text) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Subscription sub = subscriptions_[id];
+    if (!parse_subscription(text, &sub))
+      return;
+    leave(id);
+    join(id, sub);
+    std::string reply = R"({"type":"subscribed","format":")";
+    reply += wire_format_name(sub.format);
+    double rate = sub.format == WireFormat::Summary ? summary_hz_
+                                                    : rate_hz_ / divisor(sub);
+    reply += R"(","rate":)" + std::to_string(rate) + "}";
+    ws_.send({id}, WebSocketServer::make_frame(ws::kText, reply));
+  }
+
+  void on_close(ClientId id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    leave(id);
+    subscriptions_.erase(id);
+  }
+
+  void join(ClientId id, const Subscription &sub) {
+    subscriptions_[id] = sub;
+    Group &group = groups_[sub];
+    if (group.clients.empty())
+      group.id = next_group_++;
+    group.divisor = divisor(sub);
+    group.clients.push_back(id);
+  }
+
+  void leave(ClientId id) {
+    auto it = subscriptions_.find(id);
+    if (it == subscriptions_.end())
+      return;
+    auto group = groups_.find(it->second);
+    if (group == groups_.end())
+      return;
+    auto &clients = group->second.clients;
+    clients.erase(std::remove(clients.begin(), clients.end(), id),
+                  clients.end());
+    if (clients.empty()) {
+      closed_.push_back(group->second.id);
+      groups_.erase(group);
+    }
+  }
+
+  uint64_t divisor(const Subscription &sub) const {
+    if (sub.rate_hz <= 0 || sub.rate_hz >= rate_hz_)
+      return 1;
+    return std::max<uint64_t>(1, std::llround(rate_hz_ / sub.rate_hz));
+  }
+
+  const ScanView &scan_view(const VehicleState &v, const LidarView &view) {
+    CachedScan &cached = views_[view][v.vehicle_id];
+    if (cached.tick != v.tick) {
+      downsample(v.lidar_scan, view, &cached.scan);
+      cached.tick = v.tick;
+    }
+    return cached.scan;
+  }
+
+  WebSocketServer::Frame encode(const VehicleState &v, const LidarView &view,
+                                WireFormat format) {
+    auto &cache = frames_[{view, format}];
+    auto it = cache.find(v.vehicle_id);
+    if (it != cache.end() && it->second.tick == v.tick)
+      return it->second.frame;
+
+    encodes_++;
+    const ScanView &scan = scan_view(v, view);
+    WebSocketServer::Frame frame =
+        format == WireFormat::Json
+            ? WebSocketServer::make_frame(ws::kText, json_.encode(v, scan))
+            : WebSocketServer::make_frame(
+                  ws::kBinary,
+                  binary_.encode(v, scan, format == WireFormat::Quant16));
+    cache[v.vehicle_id] = {v.tick, frame};
+    return frame;
+  }
+
+  VehicleStore &store_;
+  WebSocketServer &ws_;
+  double rate_hz_;
+  const AggregationEngine *aggregator_;
+  double summary_hz_;
+  uint64_t summary_divisor_;
+  std::mutex mutex_; // Guards the client state up to closed_
+  std::map<Subscription, Group> groups_;
+  std::unordered_map<ClientId, Subscription> subscriptions_;
+  uint64_t next_group_ = 1;
+  std::vector<uint64_t> closed_; // Groups whose seen_ entry is stale
+  // Publisher only.
+  std::vector<Due> due_;
+  std::unordered_map<uint64_t, SeenTicks> seen_; // By Group::id
+  std::map<std::string, VehicleState> vehicles_; // Copy of the store
+  std::map<LidarView, std::unordered_map<std::string, CachedScan>> views_;
+  std::map<FrameKey, std::unordered_map<std::string, CachedFrame>> frames_;
+  TelemetryJson json_;
+  TelemetryBinary binary_;
+  SummaryJson summary_json_;
+  uint64_t messages_ = 0;
+  uint64_t summaries_ = 0;
+  uint64_t encodes_ = 0;
+};
+
+} // namespace omnistream
@@ -0,0 +1,411 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#include "aggregation_engine.hpp"
+#include "ingest_service.hpp"
+#include "lidar_view.hpp"
+
+namespace omnistream {
+
+// Bridge-to-browser message formats. JSON is what app.js and the Python
+// receiver always spoke; the binary formats carry the same fields in a fixed
+// little-endian header followed by the LiDAR samples, so the browser can
+// wrap the payload in a typed array without parsing anything.
+enum class WireFormat : uint8_t {
+  Json,    // {"type":"telemetry","data":{...}} text frame
+  Float32, // Binary, raw float32 ranges
+  Quant16, // Binary, uint16 ranges in units of lidar_scale metres
+  Summary, // {"type":"summary",...} rolling statistics only, no raw frames
+};
+
+inline const char *wire_format_name(WireFormat format) {
+  static const char *names[] = {"json", "f32", "q16", "summary"};
+  return names[static_cast<size_t>(format)];
+}
+
+// Parses the names above; returns false for anything else.
+inline bool parse_wire_format(std::string_view name, WireFormat *format) {
+  for (auto f : {WireFormat::Json, WireFormat::Float32, WireFormat::Quant16,
+                 WireFormat::Summary})
+    if (name == wire_format_name(f)) {
+      *format = f;
+      return true;
+    }
+  return false;
+}
+
+// What one dashboard client asked for. rate_hz = 0 means every bridge frame.
+// Vehicle ids ending in '*' match by prefix; no ids means every vehicle.
+struct Subscription {
+  WireFormat format = WireFormat::Json;
+  double rate_hz = 0.0;
+  std::vector<std::string> vehicles; // Sorted
+  LidarView view;
+
+  bool wants(const std::string &vehicle_id) const {
+    if (vehicles.empty())
+      return true;
+    for (const auto &v : vehicles) {
+      bool prefix = !v.empty() && v.back() == '*';
+      if (prefix ? vehicle_id.compare(0, v.size() - 1, v, 0,
+                                      v.size() - 1) == 0
+                 : vehicle_id == v)
+        return true;
+    }
+    return false;
+  }
+
+  bool operator<(const Subscription &o) const {
+    return std::tie(format, rate_hz, vehicles, view) <
+           std::tie(o.format, o.rate_hz, o.vehicles, o.view);
+  }
+};
+
+// Minimal lookups in a flat JSON object, enough for client control
+// messages; no nesting or escapes.
+inline std::string_view json_field(std::string_view text,
+                                   std::string_view key) {
+  std::string quoted = "\"" + std::string(key) + "\"";
+  auto at = text.find(quoted);
+  if (at == std::string_view::npos)
+    return {};
+  at = text.find(':', at + quoted.size());
+  if (at == std::string_view::npos)
+    return {};
+  at = text.find_first_not_of(" \t\r\n", at + 1);
+  if (at == std::string_view::npos)
+    return {};
+  if (text[at] == '"') {
+    auto end = text.find('"', at + 1);
+    return end == std::string_view::npos ? std::string_view{}
+                                         : text.substr(at + 1, end - at - 1);
+  }
+  if (text[at] == '[') {
+    auto end = text.find(']', at);
+    return end == std::string_view::npos ? std::string_view{}
+                                         : text.substr(at, end - at + 1);
+  }
+  auto end = text.find_first_of(",} \t\r\n", at);
+  return text.substr(at, end == std::string_view::npos ? end : end - at);
+}
+
+// Elements of a flat JSON array returned by json_field, quotes stripped.
+inline std::vector<std::string> json_array(std::string_view array) {
+  std::vector<std::string> items;
+  if (array.size() < 2 || array.front() != '[')
+    return items;
+  array = array.substr(1, array.size() - 2);
+  while (!array.empty()) {
+    auto comma = array.find(',');
+    auto item = array.substr(0, comma);
+    auto begin = item.find_first_not_of(" \t\r\n\"");
+    auto end = item.find_last_not_of(" \t\r\n\"");
+    if (begin != std::string_view::npos)
+      items.emplace_back(item.substr(begin, end - begin + 1));
+    if (comma == std::string_view::npos)
+      break;
+    array.remove_prefix(comma + 1);
+  }
+  return items;
+}
+
+// Rejects inf and nan as well as malformed text; callers still clamp
+// before converting to an integer.
+inline bool parse_number(std::string_view text, double *value) {
+  std::string s(text);
+  char *end = nullptr;
+  *value = std::strtod(s.c_str(), &end);
+  return !s.empty() && *end == '\0' && std::isfinite(*value);
+}
+
+// Parses a subscribe request, e.g.
+//   {"type":"subscribe","format":"q16","rate":20,"vehicles":["AV-001-00*"],
+//    "sector":[300,60],"decimate":2,"max_points":256}
+// Omitted fields keep their current value in `sub`. Returns false if the
+// message is not a valid subscribe request.
+inline bool parse_subscription(std::string_view text, Subscription *sub) {
+  if (json_field(text, "type") != "subscribe")
+    return false;
+  Subscription next = *sub;
+  double value = 0;
+  auto format = json_field(text, "format");
+  if (!format.empty() && !parse_wire_format(format, &next.format))
+    return false;
+  auto rate = json_field(text, "rate");
+  if (!rate.empty()) {
+    if (!parse_number(rate, &value) || value < 0)
+      return false;
+    next.rate_hz = value;
+  }
+  auto vehicles = json_field(text, "vehicles");
+  if (!vehicles.empty()) {
+    next.vehicles = json_array(vehicles);
+    std::sort(next.vehicles.begin(), next.vehicles.end());
+  }
+  auto sector = json_field(text, "sector");
+  if (!sector.empty()) {
+    auto ends = json_array(sector);
+    double start = 0, end = 0;
+    if (ends.size() != 2 || !parse_number(ends[0], &start) ||
+        !parse_number(ends[1], &end))
+      return false;
+    // Folded into range first: an out-of-range cast to float is undefined.
+    next.view.start_deg = static_cast<float>(std::fmod(start, 360.0));
+    next.view.end_deg = static_cast<float>(std::fmod(end, 360.0));
+  }
+  auto decimate = json_field(text, "decimate");
+  if (!decimate.empty()) {
+    if (!parse_number(decimate, &value) || value < 1)
+      return false;
+    next.view.decimate = static_cast<uint32_t>(std::min(value, 65535.0));
+  }
+  auto max_points = json_field(text, "max_points");
+  if (!max_points.empty()) {
+    if (!parse_number(max_points, &value) || value < 0)
+      return false;
+    next.view.max_points =
+        static_cast<uint32_t>(std::min(value, 65535.0));
+  }
+  *sub = next;
+  return true;
+}
+
+// Hand-written JSON in a reused buffer, numbers formatted with to_chars.
+// Non-finite floats are written as null.
+class JsonBuffer {
+protected:
+  template <typename T> void number(T value) {
+    char buf[24];
+    auto res = std::to_chars(buf, buf + sizeof(buf), value);
+    out_.append(buf, res.ptr);
+  }
+
+  void number(float value, int precision) {
+    char buf[48];
+    auto res = std::to_chars(buf, buf + sizeof(buf), value,
+                             std::chars_format::fixed, precision);
+    if (!std::isfinite(value) || res.ec != std::errc())
+      out_ += "null";
+    else
+      out_.append(buf, res.ptr);
+  }
+
+  void escape(const std::string &s) {
+    for (char c : s) {
+      if (c == '"' || c == '\\') {
+        out_ += '\\';
+        out_ += c;
+      } else if (static_cast<unsigned char>(c) < 0x20) {
+        char buf[8];
+        std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+        out_ += buf;
+      } else {
+        out_ += c;
+      }
+    }
+  }
+
+  std::string out_;
+};
+
+// Dashboard JSON for one vehicle, in the shape app.js expects:
+// {"type":"telemetry","data":{vehicle_id, timestamp, lidar_scan,
+// imu_reading, battery_level, tick, lidar_sector, lidar_minmax,
+// lidar_points}}. LiDAR ranges keep millimetre precision.
+class TelemetryJson : public JsonBuffer {
+public:
+  const std::string &encode(const VehicleState &v, const ScanView &scan) {
+    out_.clear();
+    out_ += R"({"type":"telemetry","data":{"vehicle_id":")";
+    escape(v.vehicle_id);
+    out_ += R"(","timestamp":)";
+    number(v.timestamp);
+    out_ += R"(,"lidar_scan":[)";
+    for (size_t i = 0; i < scan.samples.size(); ++i) {
+      if (i)
+        out_ += ',';
+      number(scan.samples[i], 3);
+    }
+    out_ += R"(],"imu_reading":{"accel_x":)";
+    number(v.accel_x, 4);
+    out_ += R"(,"accel_y":)";
+    number(v.accel_y, 4);
+    out_ += R"(,"accel_z":)";
+    number(v.accel_z, 4);
+    out_ += R"(},"battery_level":)";
+    number(v.battery_level, 4);
+    out_ += R"(,"tick":)";
+    number(v.tick);
+    out_ += R"(,"lidar_sector":[)";
+    number(scan.start_deg, 2);
+    out_ += ',';
+    number(scan.end_deg, 2);
+    out_ += R"(],"lidar_minmax":)";
+    out_ += scan.minmax ? "true" : "false";
+    out_ += R"(,"lidar_points":)";
+    number(scan.source_points);
+    out_ += "}}";
+    return out_;
+  }
+};
+
+// Fleet summary for the vehicles a client wants, e.g.
+// {"type":"summary","imu_window":300,"lidar_window":60,"percentile":0.1,
+//  "vehicles":[{"vehicle_id":"AV-001","timestamp":..,"packets":..,
+//  "imu":{"mean":9.81,"max":10.2,"stddev":0.07},"battery":99.2,
+//  "drain_per_min":0.36,"lidar_min":[..],"lidar_percentile":[..]}]}
+// Sector i of n covers i * 360 / n to (i + 1) * 360 / n degrees.
+class SummaryJson : public JsonBuffer {
+public:
+  const std::string &encode(const std::vector<VehicleSummary> &vehicles,
+                            const AggregationConfig &config,
+                            const Subscription &sub) {
+    out_.clear();
+    out_ += R"({"type":"summary","imu_window":)";
+    number(config.imu_window);
+    out_ += R"(,"lidar_window":)";
+    number(config.lidar_window);
+    out_ += R"(,"percentile":)";
+    number(config.percentile, 3);
+    out_ += R"(,"vehicles":[)";
+    bool first = true;
+    for (const auto &v : vehicles) {
+      if (!sub.wants(v.vehicle_id))
+        continue;
+      out_ += first ? "" : ",";
+      first = false;
+      out_ += R"({"vehicle_id":")";
+      escape(v.vehicle_id);
+      out_ += R"(","timestamp":)";
+      number(v.timestamp);
+      out_ += R"(,"packets":)";
+      number(v.packets);
+      out_ += R"(,"imu":{"mean":)";
+      number(v.imu_mean, 4);
+      out_ += R"(,"max":)";
+      number(v.imu_max, 4);
+      out_ += R"(,"stddev":)";
+      number(v.imu_stddev, 4);
+      out_ += R"(},"battery":)";
+      number(v.battery, 3);
+      out_ += R"(,"drain_per_min":)";
+      number(v.drain_per_min, 4);
+      out_ += R"(,"lidar_min":)";
+      array(v.sector_min);
+      out_ += R"(,"lidar_percentile":)";
+      array(v.sector_percentile);
+      out_ += '}';
+    }
+    out_ += "]}";
+    return out_;
+  }
+
+private:
+  void array(const std::vector<float> &values) {
+    out_ += '[';
+    for (size_t i = 0; i < values.size(); ++i) {
+      if (i)
+        out_ += ',';
+      number(values[i], 2);
+    }
+    out_ += ']';
+  }
+};
+
+// Binary telemetry frame, all fields little-endian:
+//
+//   0  u8   kind (kTelemetry)
+//   1  u8   LiDAR sample type: 0 = float32, 1 = uint16
+//   2  u8   flags: bit 0 = samples are per-bucket (min, max) pairs
+//   3  u8   reserved
+//   4  u32  LiDAR samples in this frame
+//   8  f64  timestamp (us since the Unix epoch)
+//   16 f64  tick
+//   24 f32  accel_x, accel_y, accel_z, battery_level
+//   40 f32  lidar_scale: metres per uint16 unit (1 for float32)
+//   44 f32  sector start and end, degrees
+//   52 u16  vehicle id length in bytes
+//   54 u16  reserved
+//   56      vehicle id (UTF-8), zero-padded to a multiple of 4
+//   ..      LiDAR samples
+//
+// The samples start 4-byte aligned, so the browser can view them in place
+// with a Float32Array or Uint16Array.
+class TelemetryBinary {
+public:
+  static constexpr uint8_t kTelemetry = 1;
+  static constexpr size_t kHeaderBytes = 56;
+  static constexpr uint8_t kMinMax = 1;
+  // uint16 resolution; coarsened only for scans longer than 65 m.
+  static constexpr float kQuantStep = 0.001f;
+
+  static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__,
+                "binary dashboard frames are written in host order");
+
+  const std::string &encode(const VehicleState &v, const ScanView &scan,
+                            bool quantize) {
+    const std::vector<float> &samples_in = scan.samples;
+    const size_t n = samples_in.size();
+    const size_t id_len = std::min<size_t>(v.vehicle_id.size(), 0xFFFF);
+    const size_t id_padded = (id_len + 3) & ~size_t(3);
+    const size_t sample = quantize ? sizeof(uint16_t) : sizeof(float);
+
+    float scale = 1.0f;
+    if (quantize) {
+      float max = 0.0f;
+      for (float d : samples_in)
+        max = std::max(max, d);
+      scale = std::max(kQuantStep, max / 65535.0f);
+    }
+
+    out_.assign(kHeaderBytes + id_padded + n * sample, '\0');
+    char *p = out_.data();
+    p[0] = static_cast<char>(kTelemetry);
+    p[1] = quantize ? 1 : 0;
+    p[2] = static_cast<char>(scan.minmax ? kMinMax : 0);
+    put<uint32_t>(p + 4, static_cast<uint32_t>(n));
+    put<double>(p + 8, static_cast<double>(v.timestamp));
+    put<double>(p + 16, static_cast<double>(v.tick));
+    put<float>(p + 24, v.accel_x);
+    put<float>(p + 28, v.accel_y);
+    put<float>(p + 32, v.accel_z);
+    put<float>(p + 36, v.battery_level);
+    put<float>(p + 40, scale);
+    put<float>(p + 44, scan.start_deg);
+    put<float>(p + 48, scan.end_deg);
+    put<uint16_t>(p + 52, static_cast<uint16_t>(id_len));
+    std::memcpy(p + kHeaderBytes, v.vehicle_id.data(), id_len);
+
+    char *samples = p + kHeaderBytes + id_padded;
+    if (!quantize) {
+      std::memcpy(samples, samples_in.data(), n * sizeof(float));
+    } else {
+      const float inv = 1.0f / scale;
+      for (size_t i = 0; i < n; ++i) {
+        float q = std::clamp(samples_in[i] * inv + 0.5f, 0.0f, 65535.0f);
+        put<uint16_t>(samples + i * 2, static_cast<uint16_t>(q));
+      }
+    }
+    return out_;
+  }
+
+private:
+  template <typename T> static void put(char *at, T value) {
+    std::memcpy(at, &value, sizeof(T));
+  }
+
+  std::string out_;
+};
+
+} // namespace omnistream
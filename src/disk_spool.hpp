@@ -0,0 +1,375 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "logger.hpp"
+#include "telemetry.pb.h"
+
+namespace omnistream {
+
+// A memory-mapped spool segment file. Records are a native-endian uint32
+// length followed by a serialized TelemetryPacket; the first zero length (or
+// the end of the file) ends the segment. Active segments are preallocated
+// and zero-filled, so a segment left behind by a crash is still readable.
+struct SpoolSegment {
+  std::string path;
+  char *data = nullptr;
+  size_t size = 0; // Mapped bytes
+  size_t used = 0; // Bytes holding records
+  bool writable = false;
+
+  static constexpr size_t kHeader = sizeof(uint32_t);
+
+  SpoolSegment() = default;
+  SpoolSegment(const SpoolSegment &) = delete;
+  SpoolSegment &operator=(const SpoolSegment &) = delete;
+  SpoolSegment(SpoolSegment &&o) noexcept { *this = std::move(o); }
+  SpoolSegment &operator=(SpoolSegment &&o) noexcept {
+    std::swap(path, o.path);
+    std::swap(data, o.data);
+    std::swap(size, o.size);
+    std::swap(used, o.used);
+    std::swap(writable, o.writable);
+    return *this;
+  }
+  ~SpoolSegment() { unmap(); }
+
+  // Creates and maps a zero-filled segment of `capacity` bytes.
+  bool create(const std::string &file, size_t capacity) {
+    int fd = ::open(file.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+      return false;
+    bool ok = ::ftruncate(fd, static_cast<off_t>(capacity)) == 0 &&
+              map(fd, capacity, true);
+    ::close(fd);
+    path = file;
+    return ok;
+  }
+
+  // Maps an existing segment read-only and finds the end of its records.
+  bool open(const std::string &file) {
+    int fd = ::open(file.c_str(), O_RDONLY);
+    if (fd < 0)
+      return false;
+    struct stat st {};
+    bool ok = ::fstat(fd, &st) == 0 && st.st_size > 0 &&
+              map(fd, static_cast<size_t>(st.st_size), false);
+    ::close(fd);
+    path = file;
+    if (!ok)
+      return false;
+    size_t offset = 0;
+    while (auto len = record_at(offset).size())
+      offset += kHeader + len;
+    used = offset;
+    return true;
+  }
+
+  bool fits(size_t len) const { return used + kHeader + len <= size; }
+
+  char *reserve(uint32_t len) {
+    std::memcpy(data + used, &len, kHeader);
+    char *payload = data + used + kHeader;
+    used += kHeader + len;
+    return payload;
+  }
+
+  // Record starting at offset; empty at the end of the segment.
+  std::string_view record_at(size_t offset) const {
+    uint32_t len = 0;
+    if (offset + kHeader > size)
+      return {};
+    std::memcpy(&len, data + offset, kHeader);
+    if (len == 0 || offset + kHeader + len > size)
+      return {};
+    return {data + offset + kHeader, len};
+  }
+
+  // Unmaps and trims a writable segment to the bytes actually used.
+  void seal() {
+    bool trim = writable;
+    unmap();
+    if (trim)
+      ::truncate(path.c_str(), static_cast<off_t>(used));
+  }
+
+private:
+  bool map(int fd, size_t bytes, bool rw) {
+    void *p = ::mmap(nullptr, bytes, rw ? PROT_READ | PROT_WRITE : PROT_READ,
+                     MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED)
+      return false;
+    data = static_cast<char *>(p);
+    size = bytes;
+    writable = rw;
+    return true;
+  }
+
+  void unmap() {
+    if (data)
+      ::munmap(data, size);
+    data = nullptr;
+    writable = false;
+  }
+};
+
+// Bounded FIFO of serialized packets on disk, used by the network thread to
+// buffer while the server is unreachable. Packets are serialized straight
+// into memory-mapped, append-only segment files; fully drained segments are
+// deleted. Segments found in the directory at startup are recovered, so a
+// backlog survives restarts. When max_segments is reached the oldest segment
+// is dropped, bounding disk use. Single-threaded: the owner appends and
+// drains.
+class DiskSpool {
+public:
+  explicit DiskSpool(const std::string &dir, size_t segment_bytes = 64 << 20,
+                     size_t max_segments = 64)
+      : dir_(dir), segment_bytes_(segment_bytes),
+        max_segments_(std::max<size_t>(2, max_segments)) {
+    std::error_code ec;
+    std::filesystem::create_directories(dir_, ec);
+    for (const auto &file : list_segments(dir_)) {
+      SpoolSegment seg;
+      uint64_t n = seg.open(file) ? count(seg) : 0;
+      if (n == 0) {
+        std::remove(file.c_str());
+        continue;
+      }
+      records_ += n;
+      next_id_ = std::max(next_id_, segment_id(file) + 1);
+      segments_.push_back(std::move(seg));
+    }
+    if (records_ > 0)
+      log_info("Spool", "Recovered").field("packets", records_).field("dir",
+                                                                    dir_);
+  }
+
+  ~DiskSpool() {
+    for (auto &seg : segments_)
+      seg.seal();
+  }
+
+  DiskSpool(const DiskSpool &) = delete;
+  DiskSpool &operator=(const DiskSpool &) = delete;
+
+  bool append(const TelemetryPacket &packet) {
+    size_t len = packet.ByteSizeLong();
+    char *out = len ? reserve(len) : nullptr;
+    if (out)
+      packet.SerializeWithCachedSizesToArray(reinterpret_cast<uint8_t *>(out));
+    return out || len == 0;
+  }
+
+  // Appends an already serialized packet.
+  bool append(const void *data, size_t len) {
+    char *out = len ? reserve(len) : nullptr;
+    if (out)
+      std::memcpy(out, data, len);
+    return out || len == 0;
+  }
+
+  // Serialized bytes of the oldest spooled packet, valid until pop_front().
+  // Only call while the spool is non-empty.
+  std::string_view front() const {
+    return segments_.front().record_at(read_offset_);
+  }
+
+  void pop_front() {
+    auto &head = segments_.front();
+    read_offset_ += SpoolSegment::kHeader + head.record_at(read_offset_).size();
+    records_--;
+    if (records_ == 0) {
+      // Fully drained: start the next outage from a fresh segment.
+      while (!segments_.empty())
+        drop_front();
+    } else if (read_offset_ >= head.used && segments_.size() > 1) {
+      drop_front();
+    }
+  }
+
+  bool empty() const { return records_ == 0; }
+  uint64_t size() const { return records_; }
+  uint64_t dropped() const { return dropped_; }
+  const std::string &dir() const { return dir_; }
+
+  // Segment files of a spool directory in write order, or a single file.
+  static std::vector<std::string> list_segments(const std::string &path) {
+    std::vector<std::string> files;
+    std::error_code ec;
+    if (!std::filesystem::is_directory(path, ec)) {
+      if (std::filesystem::exists(path, ec))
+        files.push_back(path);
+      return files;
+    }
+    for (const auto &entry : std::filesystem::directory_iterator(path, ec))
+      if (entry.path().extension() == ".seg")
+        files.push_back(entry.path().string());
+    std::sort(files.begin(), files.end());
+    return files;
+  }
+
+private:
+  char *reserve(size_t len) {
+    if (len + SpoolSegment::kHeader > segment_bytes_)
+      return nullptr;
+    if (segments_.empty() || !segments_.back().writable ||
+        !segments_.back().fits(len)) {
+      if (!roll())
+        return nullptr;
+    }
+    records_++;
+    return segments_.back().reserve(static_cast<uint32_t>(len));
+  }
+
+  bool roll() {
+    while (segments_.size() >= max_segments_) {
+      uint64_t lost = count(segments_.front(), read_offset_);
+      dropped_ += lost;
+      records_ -= lost;
+      drop_front();
+    }
+    char name[32];
+    std::snprintf(name, sizeof(name), "/%010llu.seg",
+                  static_cast<unsigned long long>(next_id_++));
+    SpoolSegment seg;
+    if (!seg.create(dir_ + name, segment_bytes_)) {
+      std::cerr << "[Spool] Cannot create segment in " << dir_ << ": "
+                << std::strerror(errno) << std::endl;
+      return false;
+    }
+    segments_.push_back(std::move(seg));
+    return true;
+  }
+
+  void drop_front() {
+    auto &head = segments_.front();
+    head.seal();
+    std::remove(head.path.c_str());
+    segments_.pop_front();
+    read_offset_ = 0;
+  }
+
+  static uint64_t count(const SpoolSegment &seg, size_t offset = 0) {
+    uint64_t n = 0;
+    while (auto len = seg.record_at(offset).size()) {
+      offset += SpoolSegment::kHeader + len;
+      n++;
+    }
+    return n;
+  }
+
+  static uint64_t segment_id(const std::string &file) {
+    return std::strtoull(
+        std::filesystem::path(file).stem().string().c_str(), nullptr, 10);
+  }
+
+  std::string dir_;
+  size_t segment_bytes_;
+  size_t max_segments_;
+  std::deque<SpoolSegment> segments_;
+  size_t read_offset_ = 0; // Into segments_.front()
+  uint64_t records_ = 0;
+  uint64_t dropped_ = 0;
+  uint64_t next_id_ = 1;
+};
+
+// Sequential read-only pass over a spool directory or segment file, for
+// replaying a recorded session. Segments are left in place.
+//
+// A session recorded with several workers has no segments of its own but
+// one worker-N subdirectory per worker; those are read side by side and
+// merged by timestamp, so the replay keeps the recorded packet order.
+class SpoolReader {
+public:
+  explicit SpoolReader(const std::string &path) {
+    for (const auto &dir : source_dirs(path)) {
+      Source source;
+      source.files = DiskSpool::list_segments(dir);
+      segments_ += source.files.size();
+      if (!source.files.empty())
+        sources_.push_back(std::move(source));
+    }
+  }
+
+  bool next(TelemetryPacket *packet) {
+    Source *earliest = nullptr;
+    for (auto &source : sources_) {
+      if (!source.has_head)
+        source.has_head = read(source, &source.head);
+      if (source.has_head &&
+          (!earliest || source.head.timestamp() < earliest->head.timestamp()))
+        earliest = &source;
+    }
+    if (!earliest)
+      return false;
+    packet->Swap(&earliest->head);
+    earliest->has_head = false;
+    return true;
+  }
+
+  size_t segments() const { return segments_; }
+  // Recorded workers merged by this reader.
+  size_t sources() const { return sources_.size(); }
+
+private:
+  struct Source {
+    std::vector<std::string> files;
+    size_t file = 0;
+    SpoolSegment seg;
+    size_t offset = 0;
+    TelemetryPacket head; // Next packet, once read
+    bool has_head = false;
+  };
+
+  // `path` itself, or its worker-N subdirectories if it has no segments.
+  static std::vector<std::string> source_dirs(const std::string &path) {
+    std::error_code ec;
+    if (!std::filesystem::is_directory(path, ec) ||
+        !DiskSpool::list_segments(path).empty())
+      return {path};
+    std::vector<std::string> dirs;
+    for (const auto &entry : std::filesystem::directory_iterator(path, ec))
+      if (entry.is_directory(ec) &&
+          entry.path().filename().string().rfind("worker-", 0) == 0)
+        dirs.push_back(entry.path().string());
+    std::sort(dirs.begin(), dirs.end());
+    return dirs.empty() ? std::vector<std::string>{path} : dirs;
+  }
+
+  static bool read(Source &source, TelemetryPacket *packet) {
+    while (true) {
+      if (source.seg.data) {
+        auto rec = source.seg.record_at(source.offset);
+        if (!rec.empty()) {
+          source.offset += SpoolSegment::kHeader + rec.size();
+          return packet->ParseFromArray(rec.data(),
+                                        static_cast<int>(rec.size()));
+        }
+      }
+      if (source.file >= source.files.size())
+        return false;
+      source.seg = SpoolSegment();
+      source.seg.open(source.files[source.file++]);
+      source.offset = 0;
+    }
+  }
+
+  std::vector<Source> sources_;
+  size_t segments_ = 0;
+};
+
+} // namespace omnistream
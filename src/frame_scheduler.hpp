@@ -0,0 +1,116 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+
+#include "spsc_ring_buffer.hpp"
+
+namespace omnistream {
+
+// What to do when a frame finishes after its deadline.
+enum class OverrunPolicy {
+  CatchUp, // Run missed frames back-to-back (bounded) to keep the average rate
+  Skip,    // Drop missed frames and stay on the original phase grid
+};
+
+// Fixed-rate frame clock on an absolute timeline.
+//
+// Deadlines are start + n * period, so sleep overshoot in one frame is paid
+// back in the next instead of accumulating as drift. The wait is a
+// sleep_until to just before the deadline, then an optional spin for the last
+// `spin` microseconds to absorb OS timer slack. Frames that finish late are
+// counted as overruns and handled per OverrunPolicy.
+class FrameScheduler {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  explicit FrameScheduler(double rate_hz,
+                          std::chrono::microseconds spin =
+                              std::chrono::microseconds(0),
+                          OverrunPolicy policy = OverrunPolicy::CatchUp,
+                          uint32_t max_catch_up = 3)
+      : period_(std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(1.0 / rate_hz))),
+        spin_(spin), policy_(policy), max_catch_up_(max_catch_up),
+        next_(Clock::now()) {
+#ifdef __linux__
+    // Default timer slack is 50 us; ask for the tightest wakeups available.
+    prctl(PR_SET_TIMERSLACK, 1UL, 0, 0, 0);
+#endif
+  }
+
+  // Blocks until the next frame is due. Call once per frame, after the work.
+  void wait() {
+    frames_++;
+    if (period_ == Clock::duration::zero())
+      return; // Unpaced
+    next_ += period_;
+
+    auto now = Clock::now();
+    if (now >= next_) {
+      // Frames replayed during catch-up start late by design; only count
+      // the frame that actually blew its deadline.
+      if (!catching_up_)
+        overruns_++;
+      uint64_t behind = (now - next_) / period_;
+      uint64_t keep = policy_ == OverrunPolicy::Skip
+                          ? 0
+                          : std::min<uint64_t>(behind, max_catch_up_);
+      // Frames beyond what we are willing to replay are dropped.
+      skipped_ += behind - keep;
+      next_ += period_ * (behind - keep);
+      if (policy_ == OverrunPolicy::Skip) {
+        next_ += period_;
+        skipped_++;
+      } else {
+        catching_up_ = true;
+        return; // Start the late frame immediately.
+      }
+    }
+    catching_up_ = false;
+
+    if (spin_.count() > 0) {
+      auto wake = next_ - spin_;
+      if (wake > now)
+        std::this_thread::sleep_until(wake);
+      while (Clock::now() < next_)
+        cpu_relax();
+    } else {
+      std::this_thread::sleep_until(next_);
+    }
+  }
+
+  // Switches to `rate_hz` from now on, without catching up on the old
+  // schedule. A rate of 0 runs frames back to back.
+  void set_rate(double rate_hz) {
+    period_ = rate_hz > 0 ? std::chrono::duration_cast<Clock::duration>(
+                                std::chrono::duration<double>(1.0 / rate_hz))
+                          : Clock::duration::zero();
+    next_ = Clock::now();
+    catching_up_ = false;
+  }
+
+  Clock::duration period() const { return period_; }
+  uint64_t frames() const { return frames_; }
+  uint64_t overruns() const { return overruns_; }
+  uint64_t skipped() const { return skipped_; }
+
+private:
+  Clock::duration period_;
+  std::chrono::microseconds spin_;
+  OverrunPolicy policy_;
+  uint32_t max_catch_up_;
+  Clock::time_point next_;
+  uint64_t frames_ = 0;
+  uint64_t overruns_ = 0;
+  uint64_t skipped_ = 0;
+  bool catching_up_ = false;
+};
+
+} // namespace omnistream
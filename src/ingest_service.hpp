@@ -0,0 +1,145 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "aggregation_engine.hpp"
+#include "lidar_codec.hpp"
+#include "telemetry.grpc.pb.h"
+#include "telemetry.pb.h"
+#include <grpcpp/grpcpp.h>
+
+namespace omnistream {
+
+// Latest merged view of one vehicle, as shown on the dashboard.
+struct VehicleState {
+  std::string vehicle_id;
+  int64_t timestamp = 0;
+  std::vector<float> lidar_scan;
+  float accel_x = 0, accel_y = 0, accel_z = 0;
+  float battery_level = 0;
+  uint64_t tick = 0; // Packets received for this vehicle; 0 = never seen
+};
+
+// Last tick a reader has seen per vehicle.
+using SeenTicks = std::unordered_map<std::string, uint64_t>;
+
+// Latest state of every vehicle, written by ingest streams and read by the
+// broadcaster. Multi-rate agents send IMU and LiDAR packets separately; they
+// are merged here so each snapshot is a complete vehicle.
+class VehicleStore {
+public:
+  void update(const TelemetryPacket &packet, const std::vector<float> *scan) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    VehicleState &state = vehicles_[packet.vehicle_id()];
+    if (state.vehicle_id.empty())
+      state.vehicle_id = packet.vehicle_id();
+    state.timestamp = packet.timestamp();
+    if (scan)
+      state.lidar_scan = *scan;
+    if (packet.channel() != TelemetryPacket::CHANNEL_LIDAR) {
+      state.accel_x = packet.imu_reading().accel_x();
+      state.accel_y = packet.imu_reading().accel_y();
+      state.accel_z = packet.imu_reading().accel_z();
+      state.battery_level = packet.battery_level();
+    }
+    state.tick++;
+  }
+
+  // Brings `copy` up to date with the store: every vehicle whose tick
+  // differs is copied over, reusing the copy's storage. Returns how many
+  // were copied. Only the copy runs under the lock, so readers do their
+  // encoding and sending from `copy` without holding up update().
+  size_t copy_updated(std::map<std::string, VehicleState> *copy) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t n = 0;
+    for (const auto &[id, state] : vehicles_) {
+      VehicleState &mine = (*copy)[id];
+      if (mine.tick == state.tick)
+        continue;
+      mine = state;
+      n++;
+    }
+    return n;
+  }
+
+  size_t size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return vehicles_.size();
+  }
+
+private:
+  mutable std::mutex mutex_;
+  std::map<std::string, VehicleState> vehicles_;
+};
+
+// TelemetryStream server for agents. Each stream acks every packet in order
+// (the async client matches acks to packets), decodes LiDAR with one decoder
+// per vehicle, and publishes the result to the VehicleStore and, if given, the
+// AggregationEngine. Decoding happens on the stream's own gRPC thread,
+// outside the store lock.
+class IngestService final : public TelemetryStream::Service {
+public:
+  explicit IngestService(VehicleStore &store,
+                         AggregationEngine *aggregator = nullptr)
+      : store_(store), aggregator_(aggregator) {}
+
+  grpc::Status
+  StreamTelemetry(grpc::ServerContext *ctx,
+                  grpc::ServerReaderWriter<ServerAck, TelemetryPacket> *stream)
+      override {
+    std::unordered_map<std::string, LidarDeltaDecoder> decoders;
+    std::vector<float> scan;
+    TelemetryPacket packet;
+    ServerAck ack;
+    uint64_t received = 0;
+    streams_++;
+    std::cout << "[Ingest] Stream opened from " << ctx->peer() << std::endl;
+
+    while (stream->Read(&packet)) {
+      received++;
+      packets_++;
+      bool has_lidar = packet.channel() != TelemetryPacket::CHANNEL_IMU;
+      bool decoded =
+          has_lidar && decoders[packet.vehicle_id()].decode(packet, &scan);
+      if (has_lidar && !decoded)
+        undecodable_++; // Delta frame after a gap; wait for a keyframe
+      store_.update(packet, decoded ? &scan : nullptr);
+      if (aggregator_)
+        aggregator_->update(packet, decoded ? &scan : nullptr);
+
+      ack.set_success(true);
+      ack.set_received_timestamp(
+          std::chrono::duration_cast<std::chrono::microseconds>(
+              std::chrono::system_clock::now().time_since_epoch())
+              .count());
+      if (!stream->Write(ack))
+        break;
+    }
+
+    streams_--;
+    std::cout << "[Ingest] Stream from " << ctx->peer() << " closed after "
+              << received << " packets" << std::endl;
+    return grpc::Status::OK;
+  }
+
+  uint64_t packets() const { return packets_; }
+  uint64_t undecodable() const { return undecodable_; }
+  int streams() const { return streams_; }
+
+private:
+  VehicleStore &store_;
+  AggregationEngine *aggregator_;
+  std::atomic<uint64_t> packets_{0};
+  std::atomic<uint64_t> undecodable_{0};
+  std::atomic<int> streams_{0};
+};
+
+} // namespace omnistream
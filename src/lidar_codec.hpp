@@ -0,0 +1,121 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "telemetry.pb.h"
+
+namespace omnistream {
+
+// Compact LIDAR_DELTA_Q16 encoding of TelemetryPacket.lidar_scan.
+//
+// Distances are quantized to 16-bit fixed point (default 1 mm steps, 65 m
+// range). Keyframes are delta-coded along the scan, every other frame against
+// the previous scan. Protobuf's zigzag varints then store typical deltas in
+// one or two bytes instead of four. Consecutive scans differ only slightly,
+// so most points fit in a single byte.
+class LidarDeltaEncoder {
+public:
+  explicit LidarDeltaEncoder(float step = 0.001f,
+                             uint32_t keyframe_interval = 30)
+      : step_(step), inv_step_(1.0f / step),
+        keyframe_interval_(std::max<uint32_t>(1, keyframe_interval)) {}
+
+  // Replaces the float scan in pkt with its quantized encoding. The float
+  // field is cleared but keeps its capacity for the next recycled use.
+  void encode(TelemetryPacket *pkt) {
+    auto *scan = pkt->mutable_lidar_scan();
+    const int n = scan->size();
+    const float *in = scan->data();
+
+    bool keyframe = sequence_ % keyframe_interval_ == 0 ||
+                    prev_.size() != static_cast<size_t>(n);
+    prev_.resize(n);
+
+    auto *q = pkt->mutable_lidar_quantized();
+    q->Clear();
+    q->Reserve(n);
+    int32_t *out = q->AddNAlreadyReserved(n);
+
+    int32_t last = 0;
+    for (int i = 0; i < n; ++i) {
+      int32_t v = quantize(in[i]);
+      out[i] = v - (keyframe ? last : prev_[i]);
+      prev_[i] = v;
+      last = v;
+    }
+
+    scan->Clear();
+    pkt->set_lidar_encoding(TelemetryPacket::LIDAR_DELTA_Q16);
+    pkt->set_lidar_quant_step(step_);
+    pkt->set_lidar_keyframe(keyframe);
+    pkt->set_lidar_sequence(sequence_++);
+  }
+
+private:
+  int32_t quantize(float dist) const {
+    float q = std::nearbyint(dist * inv_step_);
+    return static_cast<int32_t>(std::clamp(q, 0.0f, 65535.0f));
+  }
+
+  float step_;
+  float inv_step_;
+  uint32_t keyframe_interval_;
+  uint32_t sequence_ = 0;
+  std::vector<int32_t> prev_;
+};
+
+// Reconstructs float scans from one vehicle's packets, in order. Packets in
+// LIDAR_FLOAT32 pass through. After a sequence gap, delta frames are rejected
+// until the next keyframe arrives. Frames older than the last one seen, such
+// as those resent after a reconnect, are rejected without losing sync;
+// keyframe 0 is taken as a restarted sender.
+class LidarDeltaDecoder {
+public:
+  // Returns false if the scan cannot be reconstructed (missing base frame).
+  bool decode(const TelemetryPacket &pkt, std::vector<float> *out) {
+    if (pkt.lidar_encoding() != TelemetryPacket::LIDAR_DELTA_Q16) {
+      out->assign(pkt.lidar_scan().begin(), pkt.lidar_scan().end());
+      return true;
+    }
+
+    const auto &q = pkt.lidar_quantized();
+    const int n = q.size();
+    if (pkt.lidar_sequence() < next_sequence_ &&
+        !(pkt.lidar_keyframe() && pkt.lidar_sequence() == 0))
+      return false;
+    bool in_order = synced_ && pkt.lidar_sequence() == next_sequence_ &&
+                    prev_.size() == static_cast<size_t>(n);
+    next_sequence_ = pkt.lidar_sequence() + 1;
+
+    if (!pkt.lidar_keyframe() && !in_order) {
+      synced_ = false;
+      return false;
+    }
+
+    prev_.resize(n);
+    int32_t last = 0;
+    for (int i = 0; i < n; ++i) {
+      int32_t v = q.Get(i) + (pkt.lidar_keyframe() ? last : prev_[i]);
+      prev_[i] = v;
+      last = v;
+    }
+
+    out->resize(n);
+    const float step = pkt.lidar_quant_step();
+    for (int i = 0; i < n; ++i)
+      (*out)[i] = prev_[i] * step;
+
+    synced_ = true;
+    return true;
+  }
+
+private:
+  std::vector<int32_t> prev_;
+  uint32_t next_sequence_ = 0;
+  bool synced_ = false;
+};
+
+} // namespace omnistream
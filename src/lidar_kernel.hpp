@@ -0,0 +1,254 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#include <immintrin.h>
+#define OMNISTREAM_LIDAR_X86 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define OMNISTREAM_LIDAR_NEON 1
+#endif
+
+namespace omnistream {
+
+// Vectorized LiDAR scan synthesis.
+//
+// The generator produces dist[i] = base + amp * sin(phase + angle[i]) where
+// angle[i] depends only on the point index. Expanding the sine,
+//   sin(phase + angle) = sin(phase) * cos(angle) + cos(phase) * sin(angle)
+// turns the per-point transcendental into two table loads and a multiply-add;
+// sin/cos are evaluated once per scan. The kernel is picked at construction:
+// AVX2+FMA when the CPU supports it, otherwise SSE2 / NEON / scalar.
+class LidarWaveKernel {
+public:
+  // angle[i] = i / points * 2pi * lobes, matching the original scan shape.
+  explicit LidarWaveKernel(size_t points, float lobes = 4.0f)
+      : points_(points), sin_(points), cos_(points), run_(select()) {
+    for (size_t i = 0; i < points_; ++i) {
+      double angle = static_cast<double>(i) / points_ * 2.0 * M_PI * lobes;
+      sin_[i] = static_cast<float>(std::sin(angle));
+      cos_[i] = static_cast<float>(std::cos(angle));
+    }
+  }
+
+  size_t points() const { return points_; }
+
+  // Writes points() distances to out (no alignment requirement).
+  void synthesize(double phase, float base, float amp, float *out) const {
+    float a = static_cast<float>(std::sin(phase)) * amp;
+    float b = static_cast<float>(std::cos(phase)) * amp;
+    run_(cos_.data(), sin_.data(), points_, a, b, base, out);
+  }
+
+  const char *name() const { return name_of(run_); }
+
+private:
+  using KernelFn = void (*)(const float *, const float *, size_t, float, float,
+                            float, float *);
+
+  // out[i] = base + a * c[i] + b * s[i]
+  static void run_scalar(const float *c, const float *s, size_t n, float a,
+                         float b, float base, float *out) {
+    for (size_t i = 0; i < n; ++i)
+      out[i] = base + a * c[i] + b * s[i];
+  }
+
+#if OMNISTREAM_LIDAR_X86
+  static void run_sse2(const float *c, const float *s, size_t n, float a,
+                       float b, float base, float *out) {
+    const __m128 va = _mm_set1_ps(a), vb = _mm_set1_ps(b);
+    const __m128 vbase = _mm_set1_ps(base);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+      __m128 v = _mm_add_ps(vbase, _mm_mul_ps(va, _mm_loadu_ps(c + i)));
+      v = _mm_add_ps(v, _mm_mul_ps(vb, _mm_loadu_ps(s + i)));
+      _mm_storeu_ps(out + i, v);
+    }
+    run_scalar(c + i, s + i, n - i, a, b, base, out + i);
+  }
+
+  __attribute__((target("avx2,fma"))) static void
+  run_avx2(const float *c, const float *s, size_t n, float a, float b,
+           float base, float *out) {
+    const __m256 va = _mm256_set1_ps(a), vb = _mm256_set1_ps(b);
+    const __m256 vbase = _mm256_set1_ps(base);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+      __m256 v0 = _mm256_fmadd_ps(va, _mm256_loadu_ps(c + i), vbase);
+      __m256 v1 = _mm256_fmadd_ps(va, _mm256_loadu_ps(c + i + 8), vbase);
+      v0 = _mm256_fmadd_ps(vb, _mm256_loadu_ps(s + i), v0);
+      v1 = _mm256_fmadd_ps(vb, _mm256_loadu_ps(s + i + 8), v1);
+      _mm256_storeu_ps(out + i, v0);
+      _mm256_storeu_ps(out + i + 8, v1);
+    }
+    run_scalar(c + i, s + i, n - i, a, b, base, out + i);
+  }
+#endif
+
+#if OMNISTREAM_LIDAR_NEON
+  static void run_neon(const float *c, const float *s, size_t n, float a,
+                       float b, float base, float *out) {
+    const float32x4_t vbase = vdupq_n_f32(base);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+      float32x4_t v = vmlaq_n_f32(vbase, vld1q_f32(c + i), a);
+      v = vmlaq_n_f32(v, vld1q_f32(s + i), b);
+      vst1q_f32(out + i, v);
+    }
+    run_scalar(c + i, s + i, n - i, a, b, base, out + i);
+  }
+#endif
+
+  static KernelFn select() {
+#if OMNISTREAM_LIDAR_X86
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+      return run_avx2;
+    return run_sse2;
+#elif OMNISTREAM_LIDAR_NEON
+    return run_neon;
+#else
+    return run_scalar;
+#endif
+  }
+
+  static const char *name_of(KernelFn fn) {
+#if OMNISTREAM_LIDAR_X86
+    if (fn == run_avx2)
+      return "avx2";
+    if (fn == run_sse2)
+      return "sse2";
+#elif OMNISTREAM_LIDAR_NEON
+    if (fn == run_neon)
+      return "neon";
+#endif
+    (void)fn;
+    return "scalar";
+  }
+
+  size_t points_;
+  std::vector<float> sin_;
+  std::vector<float> cos_;
+  KernelFn run_;
+};
+
+namespace detail {
+
+// Taylor series for sin/cos, accurate to double precision on [-pi, pi].
+constexpr double kPi = 3.14159265358979323846;
+
+constexpr double constexpr_sin(double x) {
+  double term = x, sum = x;
+  for (int k = 1; k < 14; ++k) {
+    term *= -x * x / ((2.0 * k) * (2.0 * k + 1.0));
+    sum += term;
+  }
+  return sum;
+}
+
+constexpr double constexpr_cos(double x) {
+  double term = 1.0, sum = 1.0;
+  for (int k = 1; k < 14; ++k) {
+    term *= -x * x / ((2.0 * k - 1.0) * (2.0 * k));
+    sum += term;
+  }
+  return sum;
+}
+
+// Angle of point i of n with `lobes` periods per scan, reduced exactly to
+// [-pi, pi] in integer arithmetic before the series runs.
+constexpr double wave_angle(size_t i, size_t n, unsigned lobes) {
+  size_t k = (i * lobes) % n;
+  double angle = 2.0 * kPi * static_cast<double>(k) / static_cast<double>(n);
+  return angle > kPi ? angle - 2.0 * kPi : angle;
+}
+
+template <size_t N, unsigned Lobes, bool Sine>
+constexpr std::array<float, N> wave_table() {
+  std::array<float, N> table{};
+  for (size_t i = 0; i < N; ++i) {
+    double angle = wave_angle(i, N, Lobes);
+    table[i] = static_cast<float>(Sine ? constexpr_sin(angle)
+                                       : constexpr_cos(angle));
+  }
+  return table;
+}
+
+} // namespace detail
+
+// LidarWaveKernel for a resolution fixed at compile time. The sin/cos
+// tables are constexpr arrays built by the compiler, and the loop has a
+// constant trip count, so it is unrolled and vectorized without a scalar
+// tail. Like the dynamic kernel it picks an AVX2+FMA build at runtime when
+// the CPU has one.
+//
+// Constructed with any other point count (the generator's degraded LiDAR
+// resolutions), it falls back to a LidarWaveKernel of that size.
+template <size_t N, unsigned Lobes = 4> class FixedLidarWaveKernel {
+public:
+  static_assert(N > 0 && N % 16 == 0, "fixed resolutions are multiples of 16");
+
+  explicit FixedLidarWaveKernel(size_t points = N) : run_(select()) {
+    if (points != N)
+      fallback_.emplace(points, static_cast<float>(Lobes));
+  }
+
+  size_t points() const { return fallback_ ? fallback_->points() : N; }
+
+  void synthesize(double phase, float base, float amp, float *out) const {
+    if (fallback_)
+      return fallback_->synthesize(phase, base, amp, out);
+    float a = static_cast<float>(std::sin(phase)) * amp;
+    float b = static_cast<float>(std::cos(phase)) * amp;
+    run_(a, b, base, out);
+  }
+
+  const char *name() const {
+    if (fallback_)
+      return fallback_->name();
+#if OMNISTREAM_LIDAR_X86
+    return run_ == run_avx2 ? "fixed avx2" : "fixed sse2";
+#else
+    return "fixed";
+#endif
+  }
+
+private:
+  using KernelFn = void (*)(float, float, float, float *);
+
+  static constexpr std::array<float, N> kSin =
+      detail::wave_table<N, Lobes, true>();
+  static constexpr std::array<float, N> kCos =
+      detail::wave_table<N, Lobes, false>();
+
+  // out[i] = base + a * cos[i] + b * sin[i]
+  static void run_default(float a, float b, float base, float *out) {
+    for (size_t i = 0; i < N; ++i)
+      out[i] = base + a * kCos[i] + b * kSin[i];
+  }
+
+#if OMNISTREAM_LIDAR_X86
+  __attribute__((target("avx2,fma"))) static void
+  run_avx2(float a, float b, float base, float *out) {
+    for (size_t i = 0; i < N; ++i)
+      out[i] = base + a * kCos[i] + b * kSin[i];
+  }
+#endif
+
+  static KernelFn select() {
+#if OMNISTREAM_LIDAR_X86
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+      return run_avx2;
+#endif
+    return run_default;
+  }
+
+  KernelFn run_;
+  std::optional<LidarWaveKernel> fallback_;
+};
+
+} // namespace omnistream
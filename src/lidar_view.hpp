@@ -0,0 +1,120 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <tuple>
+#include <vector>
+
+namespace omnistream {
+
+// Which part of a LiDAR scan a dashboard client wants, and at what density.
+// Point i of an n-point scan is at i * 360 / n degrees. The sector runs
+// clockwise from start_deg to end_deg and may wrap through 0; equal ends
+// mean the full circle.
+struct LidarView {
+  float start_deg = 0.0f;
+  float end_deg = 360.0f;
+  uint32_t decimate = 1;   // Keep about 1 in N points
+  uint32_t max_points = 0; // Cap on samples sent; 0 = no cap
+
+  bool full() const {
+    return decimate <= 1 && max_points == 0 && sector_span() >= 360.0f;
+  }
+
+  float sector_span() const {
+    float span = std::fmod(end_deg - start_deg, 360.0f);
+    if (span <= 0.0f)
+      span += 360.0f;
+    return span;
+  }
+
+  bool operator<(const LidarView &o) const {
+    return std::tie(start_deg, end_deg, decimate, max_points) <
+           std::tie(o.start_deg, o.end_deg, o.decimate, o.max_points);
+  }
+};
+
+// A scan cut down to a LidarView. When the budget is smaller than the
+// sector, each bucket of consecutive points contributes its minimum and its
+// maximum, in scan order, so a thin obstacle (a short range in a single
+// point) survives downsampling instead of being skipped over. A budget of
+// one sample keeps just the sector's minimum; an odd budget is rounded down
+// to whole pairs.
+struct ScanView {
+  std::vector<float> samples;
+  bool minmax = false;        // samples are per-bucket (min, max) pairs
+  float start_deg = 0.0f;     // Angle of the first source point
+  float end_deg = 360.0f;     // Angle just past the last source point; above
+                              // 360 when the sector wraps through 0
+  uint32_t source_points = 0; // Points in the sector before downsampling
+};
+
+inline void downsample(const std::vector<float> &scan, const LidarView &view,
+                       ScanView *out) {
+  out->samples.clear();
+  out->minmax = false;
+  const size_t n = scan.size();
+  if (n == 0) {
+    out->source_points = 0;
+    return;
+  }
+
+  // Source points covered by the sector, from `first` with wrap-around.
+  const float span = view.sector_span();
+  size_t first = 0, count = n;
+  if (span < 360.0f) {
+    float start = std::fmod(view.start_deg, 360.0f);
+    if (start < 0.0f)
+      start += 360.0f;
+    first = static_cast<size_t>(start / 360.0f * n) % n;
+    count = std::clamp<size_t>(
+        static_cast<size_t>(std::ceil(span / 360.0f * n)), 1, n);
+  }
+  out->start_deg = first * 360.0f / n;
+  out->end_deg = out->start_deg + count * 360.0f / n;
+  out->source_points = static_cast<uint32_t>(count);
+
+  size_t budget = (count + std::max(1u, view.decimate) - 1) /
+                  std::max(1u, view.decimate);
+  if (view.max_points > 0)
+    budget = std::min<size_t>(budget, view.max_points);
+  auto at = [&](size_t i) { return scan[(first + i) % n]; };
+
+  if (budget >= count) {
+    out->samples.reserve(count);
+    for (size_t i = 0; i < count; ++i)
+      out->samples.push_back(at(i));
+    return;
+  }
+
+  if (budget == 1) {
+    // No room for a pair: the nearest return is the one worth keeping.
+    float nearest = at(0);
+    for (size_t i = 1; i < count; ++i)
+      nearest = std::min(nearest, at(i));
+    out->samples.push_back(nearest);
+    return;
+  }
+
+  // Pairs only: an odd budget leaves its last sample unused.
+  const size_t buckets = budget / 2;
+  out->minmax = true;
+  out->samples.reserve(buckets * 2);
+  for (size_t b = 0; b < buckets; ++b) {
+    size_t lo = b * count / buckets;
+    size_t hi = (b + 1) * count / buckets;
+    size_t min_i = lo, max_i = lo;
+    for (size_t i = lo + 1; i < hi; ++i) {
+      float v = at(i);
+      if (v < at(min_i))
+        min_i = i;
+      if (v > at(max_i))
+        max_i = i;
+    }
+    out->samples.push_back(at(std::min(min_i, max_i)));
+    out->samples.push_back(at(std::max(min_i, max_i)));
+  }
+}
+
+} // namespace omnistream
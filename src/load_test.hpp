@@ -0,0 +1,261 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <ostream>
+#include <vector>
+
+#include <sys/resource.h>
+
+#include "logger.hpp"
+#include "metrics.hpp"
+
+namespace omnistream {
+
+struct LoadTestOptions {
+  std::chrono::milliseconds step{5000}; // Measured time per rate
+  double p99_us = 10000.0;              // Queue-stage p99 target
+  size_t max_doublings = 16;
+  size_t refine_steps = 3;
+};
+
+// Saturation search for --load-test, advanced from main()'s loop. The
+// producers follow rate_scale(): every configured rate multiplied by it,
+// 0 for unpaced, negative for paused. The ramp doubles the scale while a
+// step is sustained, bisects between the last sustained and the first
+// saturated scale, and ends with one unpaced step for the raw ceiling.
+//
+// A step is sustained when the network threads dequeue at least 95% of the
+// offered packet rate, the p99 from capture to dequeue (the queue stage)
+// stays under the target, and the queues drop nothing. Between steps the
+// producers pause until the queues are empty, so a saturated step's
+// backlog does not count against the next one. Each step first settles for
+// a fifth of its length before it is measured.
+class LoadRamp {
+public:
+  using Clock = std::chrono::steady_clock;
+  static constexpr auto kSampleInterval = std::chrono::milliseconds(100);
+  static constexpr auto kDrainLimit = std::chrono::seconds(5);
+  static constexpr double kPaused = -1.0;
+  static constexpr double kSustainedFraction = 0.95;
+
+  struct Probe {
+    std::function<size_t()> queue_depth; // Packets queued, all pipelines
+    std::function<uint64_t()> dropped;   // Overflow drops so far
+  };
+
+  struct Step {
+    double scale = 0;   // 0: unpaced
+    double offered = 0; // Packets/s asked of the producers; 0 if unpaced
+    double sent = 0;    // Packets/s dequeued by the network threads
+    Metrics::Summary queue, write;
+    double cpu_per_packet_us = 0; // Whole process, all threads
+    double depth_mean = 0;
+    size_t depth_max = 0;
+    uint64_t dropped = 0;
+    bool sustained = false;
+  };
+
+  // `rate_hz` and `packets_per_s` are the configured frame rate and the
+  // packet rate it produces over all vehicles, at scale 1.
+  LoadRamp(LoadTestOptions opts, double rate_hz, double packets_per_s,
+           Probe probe)
+      : opts_(opts), rate_hz_(rate_hz), packets_per_s_(packets_per_s),
+        probe_(std::move(probe)) {}
+
+  const std::atomic<double> &rate_scale() const { return scale_; }
+
+  // Call every kSampleInterval from the start of the run. Returns false
+  // once the unpaced step has been measured.
+  bool sample(Clock::time_point now) {
+    switch (phase_) {
+    case Phase::Start:
+      begin_step(now, 1.0);
+      break;
+    case Phase::Drain:
+      if (probe_.queue_depth() == 0 || now >= deadline_)
+        begin_step(now, next_scale_);
+      break;
+    case Phase::Settle:
+      if (now >= deadline_) {
+        baseline_ = Metrics::instance().snapshot();
+        cpu_us_ = process_cpu_us();
+        dropped_ = probe_.dropped();
+        depth_sum_ = 0;
+        depth_samples_ = 0;
+        depth_max_ = 0;
+        measure_start_ = now;
+        deadline_ = now + opts_.step;
+        phase_ = Phase::Measure;
+      }
+      break;
+    case Phase::Measure: {
+      size_t depth = probe_.queue_depth();
+      depth_sum_ += depth;
+      depth_samples_++;
+      depth_max_ = std::max(depth_max_, depth);
+      if (now >= deadline_)
+        finish_step(now);
+      break;
+    }
+    case Phase::Done:
+      break;
+    }
+    return phase_ != Phase::Done;
+  }
+
+  const std::vector<Step> &steps() const { return steps_; }
+
+  void report(std::ostream &out) const {
+    char line[160];
+    std::snprintf(line, sizeof(line),
+                  "%-7s %8s %10s %10s %9s %9s %8s %9s %9s %7s", "[Load]",
+                  "rate x", "offered/s", "sent/s", "q p99 us", "w p99 us",
+                  "cpu us", "depth avg", "depth max", "dropped");
+    out << line << "\n";
+    for (const Step &step : steps_) {
+      char scale[16];
+      if (step.scale > 0)
+        std::snprintf(scale, sizeof(scale), "%.5g", step.scale);
+      else
+        std::snprintf(scale, sizeof(scale), "unpaced");
+      std::snprintf(line, sizeof(line),
+                    "%-7s %8s %10.0f %10.0f %9.1f %9.1f %8.2f %9.1f %9zu %7llu",
+                    step.scale == 0 ? "max"
+                    : step.sustained ? "ok"
+                                     : "SAT",
+                    scale, step.offered, step.sent, step.queue.p99,
+                    step.write.p99, step.cpu_per_packet_us, step.depth_mean,
+                    step.depth_max,
+                    static_cast<unsigned long long>(step.dropped));
+      out << line << "\n";
+    }
+
+    const Step *best = nullptr;
+    for (const Step &step : steps_)
+      if (step.sustained && (!best || step.scale > best->scale))
+        best = &step;
+    if (best)
+      std::snprintf(line, sizeof(line),
+                    "[Load] Max sustained %.0f packets/s at %.1f Hz per "
+                    "vehicle (queue p99 %.1f us, %.2f us CPU per packet)",
+                    best->sent, rate_hz_ * best->scale, best->queue.p99,
+                    best->cpu_per_packet_us);
+    else
+      std::snprintf(line, sizeof(line),
+                    "[Load] No rate sustained with queue p99 <= %.0f us",
+                    opts_.p99_us);
+    out << line << "\n";
+    if (!steps_.empty() && steps_.back().scale == 0) {
+      std::snprintf(line, sizeof(line),
+                    "[Load] Unpaced ceiling %.0f packets/s (queue p99 %.1f "
+                    "us)",
+                    steps_.back().sent, steps_.back().queue.p99);
+      out << line << "\n";
+    }
+    out.flush();
+  }
+
+private:
+  enum class Phase { Start, Drain, Settle, Measure, Done };
+  enum class Search { Ramp, Refine, Unpaced };
+
+  void begin_step(Clock::time_point now, double scale) {
+    scale_ = scale;
+    deadline_ = now + opts_.step / 5;
+    phase_ = Phase::Settle;
+  }
+
+  void finish_step(Clock::time_point now) {
+    Metrics::Snapshot snap = Metrics::instance().snapshot();
+    std::chrono::duration<double> elapsed = now - measure_start_;
+    Step step;
+    step.scale = scale_;
+    step.offered = scale_ * packets_per_s_;
+    step.queue = Metrics::summarize(baseline_, snap, Stage::QueueDwell);
+    step.write = Metrics::summarize(baseline_, snap, Stage::Write);
+    step.sent = step.queue.count / elapsed.count();
+    if (step.queue.count > 0)
+      step.cpu_per_packet_us =
+          static_cast<double>(process_cpu_us() - cpu_us_) / step.queue.count;
+    step.depth_mean =
+        depth_samples_ ? static_cast<double>(depth_sum_) / depth_samples_ : 0;
+    step.depth_max = depth_max_;
+    step.dropped = probe_.dropped() - dropped_;
+    step.sustained = step.scale > 0 &&
+                     step.sent >= kSustainedFraction * step.offered &&
+                     step.queue.p99 <= opts_.p99_us && step.dropped == 0;
+    steps_.push_back(step);
+
+    log_info("Load", step.scale == 0 ? "Unpaced"
+                     : step.sustained ? "Sustained"
+                                      : "Saturated")
+        .field("rate_hz", rate_hz_ * step.scale)
+        .field("offered", static_cast<uint64_t>(step.offered))
+        .field("sent", static_cast<uint64_t>(step.sent))
+        .field("queue_p99_us", step.queue.p99)
+        .field("cpu_us", step.cpu_per_packet_us)
+        .field("depth_mean", step.depth_mean)
+        .field("depth_max", step.depth_max)
+        .field("dropped", step.dropped);
+
+    if (search_ == Search::Unpaced) {
+      scale_ = kPaused;
+      phase_ = Phase::Done;
+      return;
+    }
+    next_scale_ = next_scale(step);
+    scale_ = kPaused;
+    deadline_ = now + kDrainLimit;
+    phase_ = Phase::Drain;
+  }
+
+  double next_scale(const Step &step) {
+    if (step.sustained)
+      good_ = std::max(good_, step.scale);
+    else
+      bad_ = bad_ > 0 ? std::min(bad_, step.scale) : step.scale;
+    if (search_ == Search::Ramp && step.sustained &&
+        ++doublings_ < opts_.max_doublings)
+      return step.scale * 2;
+    search_ = Search::Refine;
+    if (bad_ > 0 && refined_++ < opts_.refine_steps)
+      return (good_ + bad_) / 2;
+    search_ = Search::Unpaced;
+    return 0.0;
+  }
+
+  static int64_t process_cpu_us() {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    auto us = [](const timeval &tv) {
+      return static_cast<int64_t>(tv.tv_sec) * 1000000 + tv.tv_usec;
+    };
+    return us(usage.ru_utime) + us(usage.ru_stime);
+  }
+
+  LoadTestOptions opts_;
+  double rate_hz_;
+  double packets_per_s_;
+  Probe probe_;
+  std::atomic<double> scale_{kPaused};
+
+  Phase phase_ = Phase::Start;
+  Search search_ = Search::Ramp;
+  Clock::time_point deadline_, measure_start_;
+  double next_scale_ = 0, good_ = 0, bad_ = 0;
+  size_t doublings_ = 0, refined_ = 0;
+
+  Metrics::Snapshot baseline_;
+  int64_t cpu_us_ = 0;
+  uint64_t dropped_ = 0;
+  uint64_t depth_sum_ = 0;
+  size_t depth_samples_ = 0, depth_max_ = 0;
+  std::vector<Step> steps_;
+};
+
+} // namespace omnistream
@@ -0,0 +1,474 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "capture_clock.hpp"
+#include "spsc_ring_buffer.hpp"
+
+namespace omnistream {
+
+enum class LogLevel : uint8_t { Debug, Info, Warn, Error };
+enum class LogFormat { Text, Json };
+
+inline bool parse_log_level(const std::string &name, LogLevel *out) {
+  static const char *names[] = {"debug", "info", "warn", "error"};
+  for (size_t i = 0; i < 4; ++i)
+    if (name == names[i]) {
+      *out = static_cast<LogLevel>(i);
+      return true;
+    }
+  return false;
+}
+
+inline const char *log_level_name(LogLevel level) {
+  static const char *names[] = {"debug", "info", "warn", "error"};
+  return names[static_cast<size_t>(level)];
+}
+
+// One queued log line. Fixed size and trivially copyable, so enqueueing is
+// a copy into a preallocated ring: no allocation, locking or formatting on
+// the logging thread beyond appending the message text. Field keys must be
+// string literals; string values are copied into the text arena.
+struct LogRecord {
+  static constexpr size_t kTagBytes = 24;
+  static constexpr size_t kTextBytes = 224;
+  static constexpr size_t kMaxFields = 8;
+
+  enum class Type : uint8_t { Int, Uint, Float, Text };
+  struct Field {
+    const char *key;
+    Type type;
+    uint16_t offset, length; // Type::Text: span of the text arena
+    union {
+      int64_t i;
+      uint64_t u;
+      double f;
+    };
+  };
+
+  int64_t timestamp = 0; // Wall clock, microseconds
+  LogLevel level = LogLevel::Info;
+  uint8_t fields = 0;
+  uint16_t message_length = 0; // text[0, message_length) is the message
+  uint16_t text_used = 0;
+  char tag[kTagBytes] = {};
+  char text[kTextBytes];
+  Field field[kMaxFields];
+
+  // Appends up to the arena's end; longer text is truncated.
+  size_t append(std::string_view s) {
+    size_t n = std::min(s.size(), kTextBytes - text_used);
+    std::memcpy(text + text_used, s.data(), n);
+    text_used = static_cast<uint16_t>(text_used + n);
+    return n;
+  }
+};
+
+// Token bucket for one log site: at most `per_second` lines on average,
+// in bursts of up to `burst`. Lines it refuses are counted and reported as
+// a `suppressed` field on the next line that gets through. One instance
+// per site and thread; 0 lines per second disables the limit.
+class LogRateLimit {
+public:
+  explicit LogRateLimit(double per_second, double burst = 5)
+      : rate_(per_second), burst_(std::max(1.0, burst)), tokens_(burst_) {}
+
+  bool allow() {
+    if (rate_ <= 0)
+      return true;
+    int64_t now = CaptureClock::local().now();
+    if (last_us_ != 0)
+      tokens_ = std::min(burst_, tokens_ + (now - last_us_) * rate_ / 1e6);
+    last_us_ = now;
+    if (tokens_ < 1.0) {
+      suppressed_++;
+      return false;
+    }
+    tokens_ -= 1.0;
+    return true;
+  }
+
+  uint64_t take_suppressed() { return std::exchange(suppressed_, 0); }
+
+private:
+  double rate_, burst_, tokens_;
+  int64_t last_us_ = 0;
+  uint64_t suppressed_ = 0;
+};
+
+// Process-wide asynchronous log sink. Each logging thread gets its own SPSC
+// ring of LogRecords; a background flusher drains every ring each
+// flush_interval, orders the batch by timestamp, formats it and writes it
+// to stdout in one call. Only the flusher ever blocks on stdout. A full
+// ring drops the line and the flusher reports how many were lost.
+//
+// Before start() and after stop(), lines are formatted and written
+// synchronously, so short-lived tools and shutdown messages still appear.
+class Logger {
+public:
+  struct Options {
+    LogLevel level = LogLevel::Info;
+    LogFormat format = LogFormat::Text;
+    double rate = 10; // Default per-site limit, lines per second
+    std::chrono::milliseconds flush_interval{20};
+    size_t buffer_records = 1024; // Per thread
+  };
+
+  static Logger &instance() {
+    static Logger logger;
+    return logger;
+  }
+
+  // Call once, before the threads that log start.
+  void start(const Options &options) {
+    options_ = options;
+    level_ = options.level;
+    running_ = true;
+    flusher_ = std::thread([this] { flush_loop(); });
+  }
+
+  // Drains every ring and stops the flusher.
+  void stop() {
+    if (!running_.exchange(false))
+      return;
+    wake_.notify_one();
+    flusher_.join();
+  }
+
+  bool enabled(LogLevel level) const { return level >= level_.load(); }
+  double default_rate() const { return options_.rate; }
+  uint64_t dropped() const { return dropped_; }
+
+  void submit(const LogRecord &record) {
+    if (!running_) {
+      std::string out;
+      format(record, &out);
+      std::lock_guard<std::mutex> lock(sync_mutex_);
+      std::fwrite(out.data(), 1, out.size(), stdout);
+      std::fflush(stdout);
+      return;
+    }
+    local_ring().push(record);
+  }
+
+private:
+  struct Ring {
+    explicit Ring(size_t capacity) : records(capacity) {
+      records.set_overflow(OverflowPolicy::DropNewest);
+    }
+    SpscRingBuffer<LogRecord> records;
+    std::atomic<bool> orphaned{false}; // Owning thread has exited
+  };
+
+  // Registers the calling thread's ring on first use; the flusher frees it
+  // once the thread has exited and the ring is empty.
+  struct Registration {
+    explicit Registration(Logger &logger)
+        : ring(std::make_shared<Ring>(logger.options_.buffer_records)) {
+      std::lock_guard<std::mutex> lock(logger.rings_mutex_);
+      logger.rings_.push_back(ring);
+    }
+    ~Registration() { ring->orphaned = true; }
+    std::shared_ptr<Ring> ring;
+  };
+
+  Logger() = default;
+  ~Logger() { stop(); }
+
+  SpscRingBuffer<LogRecord> &local_ring() {
+    thread_local Registration registration(*this);
+    return registration.ring->records;
+  }
+
+  void flush_loop() {
+    std::string out;
+    std::vector<LogRecord> batch;
+    std::unique_lock<std::mutex> lock(wake_mutex_);
+    while (running_) {
+      wake_.wait_for(lock, options_.flush_interval);
+      flush(&batch, &out);
+    }
+    flush(&batch, &out);
+  }
+
+  void flush(std::vector<LogRecord> *batch, std::string *out) {
+    batch->clear();
+    uint64_t dropped = 0;
+    {
+      std::lock_guard<std::mutex> lock(rings_mutex_);
+      for (auto it = rings_.begin(); it != rings_.end();) {
+        Ring &ring = **it;
+        bool orphaned = ring.orphaned;
+        while (auto record = ring.records.try_pop())
+          batch->push_back(*record);
+        if (orphaned) {
+          retired_drops_ += ring.records.dropped();
+          it = rings_.erase(it);
+        } else {
+          dropped += ring.records.dropped();
+          ++it;
+        }
+      }
+    }
+    dropped += retired_drops_;
+
+    std::stable_sort(batch->begin(), batch->end(),
+                     [](const LogRecord &a, const LogRecord &b) {
+                       return a.timestamp < b.timestamp;
+                     });
+    out->clear();
+    for (const auto &record : *batch)
+      format(record, out);
+    if (dropped > dropped_) {
+      LogRecord note;
+      note.timestamp = batch->empty() ? 0 : batch->back().timestamp;
+      note.level = LogLevel::Warn;
+      std::strcpy(note.tag, "Log");
+      note.message_length = static_cast<uint16_t>(
+          note.append("Lines dropped, log buffer full"));
+      note.field[0].key = "dropped";
+      note.field[0].type = LogRecord::Type::Uint;
+      note.field[0].u = dropped - dropped_;
+      note.fields = 1;
+      format(note, out);
+      dropped_ = dropped;
+    }
+    if (!out->empty()) {
+      std::fwrite(out->data(), 1, out->size(), stdout);
+      std::fflush(stdout);
+    }
+  }
+
+  void format(const LogRecord &r, std::string *out) const {
+    std::string_view message(r.text, r.message_length);
+    if (options_.format == LogFormat::Json) {
+      *out += "{\"ts\":";
+      *out += std::to_string(r.timestamp);
+      *out += ",\"level\":\"";
+      *out += log_level_name(r.level);
+      *out += "\",\"tag\":";
+      append_json_string(r.tag, out);
+      *out += ",\"msg\":";
+      append_json_string(message, out);
+      for (size_t i = 0; i < r.fields; ++i) {
+        *out += ",\"";
+        *out += r.field[i].key;
+        *out += "\":";
+        append_value(r, r.field[i], true, out);
+      }
+      *out += "}\n";
+      return;
+    }
+    *out += '[';
+    *out += r.tag;
+    *out += ']';
+    if (r.level >= LogLevel::Warn)
+      *out += r.level == LogLevel::Warn ? " WARN" : " ERROR";
+    if (!message.empty()) {
+      *out += ' ';
+      *out += message;
+    }
+    for (size_t i = 0; i < r.fields; ++i) {
+      *out += ' ';
+      *out += r.field[i].key;
+      *out += '=';
+      append_value(r, r.field[i], false, out);
+    }
+    *out += '\n';
+  }
+
+  static void append_value(const LogRecord &r, const LogRecord::Field &f,
+                           bool json, std::string *out) {
+    char buf[32];
+    switch (f.type) {
+    case LogRecord::Type::Int:
+      *out += std::to_string(f.i);
+      break;
+    case LogRecord::Type::Uint:
+      *out += std::to_string(f.u);
+      break;
+    case LogRecord::Type::Float:
+      std::snprintf(buf, sizeof(buf), "%.6g", f.f);
+      *out += buf;
+      break;
+    case LogRecord::Type::Text: {
+      std::string_view text(r.text + f.offset, f.length);
+      if (json)
+        append_json_string(text, out);
+      else
+        *out += text;
+      break;
+    }
+    }
+  }
+
+  static void append_json_string(std::string_view s, std::string *out) {
+    *out += '"';
+    for (char c : s) {
+      if (c == '"' || c == '\\') {
+        *out += '\\';
+        *out += c;
+      } else if (static_cast<unsigned char>(c) < 0x20) {
+        char buf[8];
+        std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+        *out += buf;
+      } else {
+        *out += c;
+      }
+    }
+    *out += '"';
+  }
+
+  Options options_;
+  std::atomic<LogLevel> level_{LogLevel::Info};
+  std::atomic<bool> running_{false};
+  std::thread flusher_;
+  std::mutex wake_mutex_;
+  std::condition_variable wake_;
+  std::mutex rings_mutex_;
+  std::vector<std::shared_ptr<Ring>> rings_;
+  uint64_t retired_drops_ = 0; // Flusher only
+  uint64_t dropped_ = 0;       // Reported so far
+  std::mutex sync_mutex_;
+};
+
+// Builds one record on the stack and submits it when it goes out of scope:
+//
+//   log_info(tag, "Tick", &limit).field("tick", ticks).field("queue", n);
+//   log_info("Network") << "Connected to " << address;
+//
+// A line below the level threshold, or refused by its rate limit, costs a
+// branch per call and is never formatted.
+class LogLine {
+public:
+  LogLine(LogLevel level, std::string_view tag, std::string_view message,
+          LogRateLimit *limit)
+      : enabled_(Logger::instance().enabled(level) &&
+                 (!limit || limit->allow())) {
+    if (!enabled_)
+      return;
+    CaptureClock &clock = CaptureClock::local();
+    record_.timestamp = clock.now() + clock.wall_offset();
+    record_.level = level;
+    size_t n = std::min(tag.size(), LogRecord::kTagBytes - 1);
+    std::memcpy(record_.tag, tag.data(), n);
+    record_.tag[n] = '\0';
+    *this << message;
+    if (limit)
+      if (uint64_t suppressed = limit->take_suppressed())
+        field("suppressed", suppressed);
+  }
+
+  ~LogLine() {
+    if (enabled_)
+      Logger::instance().submit(record_);
+  }
+
+  LogLine(const LogLine &) = delete;
+  LogLine &operator=(const LogLine &) = delete;
+
+  // Message text. Only valid before the first string field.
+  LogLine &operator<<(std::string_view s) {
+    if (enabled_ && !has_text_field_)
+      record_.message_length =
+          static_cast<uint16_t>(record_.message_length + record_.append(s));
+    return *this;
+  }
+  LogLine &operator<<(const char *s) { return *this << std::string_view(s); }
+  LogLine &operator<<(const std::string &s) {
+    return *this << std::string_view(s);
+  }
+  LogLine &operator<<(char c) { return *this << std::string_view(&c, 1); }
+  template <typename T>
+  std::enable_if_t<std::is_arithmetic_v<T>, LogLine &> operator<<(T value) {
+    char buf[32];
+    if constexpr (std::is_floating_point_v<T>) {
+      int n = std::snprintf(buf, sizeof(buf), "%g", static_cast<double>(value));
+      return *this << std::string_view(buf, static_cast<size_t>(n));
+    } else {
+      auto end = std::to_chars(buf, buf + sizeof(buf), value).ptr;
+      return *this << std::string_view(buf, static_cast<size_t>(end - buf));
+    }
+  }
+
+  // Structured fields; `key` must be a string literal.
+  template <typename T>
+  std::enable_if_t<std::is_arithmetic_v<T>, LogLine &> field(const char *key,
+                                                             T value) {
+    if (LogRecord::Field *f = next_field(key)) {
+      if constexpr (std::is_floating_point_v<T>) {
+        f->type = LogRecord::Type::Float;
+        f->f = value;
+      } else if constexpr (std::is_signed_v<T>) {
+        f->type = LogRecord::Type::Int;
+        f->i = value;
+      } else {
+        f->type = LogRecord::Type::Uint;
+        f->u = value;
+      }
+    }
+    return *this;
+  }
+  LogLine &field(const char *key, std::string_view value) {
+    if (LogRecord::Field *f = next_field(key)) {
+      f->type = LogRecord::Type::Text;
+      f->offset = record_.text_used;
+      f->length = static_cast<uint16_t>(record_.append(value));
+      has_text_field_ = true;
+    }
+    return *this;
+  }
+  LogLine &field(const char *key, const char *value) {
+    return field(key, std::string_view(value));
+  }
+  LogLine &field(const char *key, const std::string &value) {
+    return field(key, std::string_view(value));
+  }
+
+private:
+  LogRecord::Field *next_field(const char *key) {
+    if (!enabled_ || record_.fields == LogRecord::kMaxFields)
+      return nullptr;
+    LogRecord::Field *f = &record_.field[record_.fields++];
+    f->key = key;
+    return f;
+  }
+
+  bool enabled_;
+  bool has_text_field_ = false;
+  LogRecord record_;
+};
+
+inline LogLine log_debug(std::string_view tag, std::string_view message = {},
+                        LogRateLimit *limit = nullptr) {
+  return LogLine(LogLevel::Debug, tag, message, limit);
+}
+inline LogLine log_info(std::string_view tag, std::string_view message = {},
+                        LogRateLimit *limit = nullptr) {
+  return LogLine(LogLevel::Info, tag, message, limit);
+}
+inline LogLine log_warn(std::string_view tag, std::string_view message = {},
+                        LogRateLimit *limit = nullptr) {
+  return LogLine(LogLevel::Warn, tag, message, limit);
+}
+inline LogLine log_error(std::string_view tag, std::string_view message = {},
+                        LogRateLimit *limit = nullptr) {
+  return LogLine(LogLevel::Error, tag, message, limit);
+}
+
+} // namespace omnistream
@@ -1,59 +1,472 @@
+#include <algorithm>
 #include <atomic>
 #include <chrono>
-#include <csignal>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
 #include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
 #include <thread>
+#include <vector>
 
+#include "async_network_client.hpp"
+#include "capture_clock.hpp"
+#include "cli_args.hpp"
+#include "channel_router.hpp"
+#include "disk_spool.hpp"
+#include "frame_scheduler.hpp"
+#include "load_test.hpp"
+#include "logger.hpp"
+#include "metrics.hpp"
 #include "network_client.hpp"
+#include "packet_pool.hpp"
+#include "packet_queue.hpp"
 #include "sensor_generator.hpp"
+#include "shutdown.hpp"
 #include "telemetry.pb.h"
-#include "thread_safe_queue.hpp"
+#include "thread_tuning.hpp"
+#include "trace_source.hpp"
+#include "wire_packet.hpp"
 
 using namespace omnistream;
 
 std::atomic<bool> running{true};
 
-void on_signal(int) {
-  std::cout << "\nShutting down..." << std::endl;
-  running = false;
+// One physics worker, the vehicles it simulates, and the network thread that
+// drains its queue over a dedicated gRPC channel.
+struct Pipeline {
+  Pipeline(size_t index, size_t capacity)
+      : index(index), pool(capacity), queue(capacity) {}
+
+  std::string tag(const char *stage) const {
+    return std::string(stage) + " " + std::to_string(index);
+  }
+
+  size_t index;
+  std::vector<std::string> vehicles;
+  // Declared before the queue so it outlives every packet still queued.
+  PacketPool pool;
+  PacketQueue queue;
+  // Shutdown drain: main() cancels a network thread that misses the
+  // deadline; the thread sets `done` and reports what it gave up.
+  DrainCancel cancel;
+  std::atomic<bool> done{false};
+  uint64_t sent = 0;
+  uint64_t lost = 0;
+  size_t spooled = 0; // Left in the spool for the next run
+};
+
+// Per-worker subdirectory of a spool or recording directory.
+std::string worker_dir(const std::string &base, size_t index, bool single) {
+  return single ? base : base + "/worker-" + std::to_string(index);
 }
 
-void physics_thread(ThreadSafeQueue<std::unique_ptr<TelemetryPacket>> &queue,
-                    const std::string &vehicle_id) {
-  SensorGenerator sensor(vehicle_id);
-  const auto frame = std::chrono::microseconds(16667); // 60 Hz
+std::string vehicle_name(const std::string &base, size_t index, size_t count) {
+  if (count == 1)
+    return base;
+  std::string n = std::to_string(index + 1);
+  return base + "-" + std::string(n.size() < 4 ? 4 - n.size() : 0, '0') + n;
+}
+
+struct SensorOptions {
+  double rate_hz = 60.0;
+  // Per-channel rates; 0 sends combined packets at rate_hz. Setting either
+  // one splits IMU and LiDAR into separate packets on their own schedules.
+  double imu_hz = 0.0;
+  double lidar_hz = 0.0;
+  std::chrono::microseconds spin{0};
+  OverrunPolicy overrun = OverrunPolicy::CatchUp;
+  size_t lidar_points = 1024;
+  bool delta_encoding = false;
+  float quant_step = 0.001f;
+  uint32_t keyframe_interval = 30;
+  std::string record_dir; // Copy of every generated packet, for --replay
+  bool pre_serialize = false; // Encode on this thread, not the network one
+  bool degrade_lidar = false;  // Halve LiDAR resolution under backpressure
+  bool fixed_kernel = false;   // Compile-time kernel for common resolutions
+  std::shared_ptr<const TraceFile> trace; // Play this log, don't synthesize
+  // --load-test: multiplier on every rate; 0 is unpaced, negative paused.
+  const std::atomic<double> *rate_scale = nullptr;
+
+  bool multi_rate() const { return imu_hz > 0 || lidar_hz > 0; }
+  double imu_rate() const { return imu_hz > 0 ? imu_hz : rate_hz; }
+  double lidar_rate() const { return lidar_hz > 0 ? lidar_hz : rate_hz; }
+  // Frame clock rate: every packet is emitted on a frame boundary.
+  double frame_rate() const {
+    return multi_rate() ? std::max(imu_rate(), lidar_rate()) : rate_hz;
+  }
+};
+
+// Spreads a channel's samples over a faster frame clock: due() is true on
+// rate/frame_rate of the frames, evenly spaced.
+class ChannelDivider {
+public:
+  ChannelDivider(double rate, double frame_rate)
+      : step_(rate / frame_rate), credit_(1.0) {}
+
+  bool due() {
+    if (credit_ < 1.0 - 1e-9) { // Tolerate rounding in the running sum
+      credit_ += step_;
+      return false;
+    }
+    credit_ += step_ - 1.0;
+    return true;
+  }
+
+private:
+  double step_;
+  double credit_;
+};
+
+void physics_thread(Pipeline &pipe, const SensorOptions &opts, bool single) {
+  const std::string tag = single ? "Physics" : pipe.tag("Physics");
+  std::vector<std::unique_ptr<SensorSource>> sensors;
+  sensors.reserve(pipe.vehicles.size());
+  for (const auto &id : pipe.vehicles) {
+    if (opts.trace)
+      // Start each vehicle at its own point in the log.
+      sensors.push_back(std::make_unique<TraceSource>(
+          id, opts.trace, opts.lidar_points, std::hash<std::string>{}(id),
+          &pipe.pool));
+    else
+      sensors.push_back(make_sensor_generator(id, opts.lidar_points,
+                                              &pipe.pool, opts.fixed_kernel));
+    if (opts.delta_encoding)
+      sensors.back()->set_lidar_encoder(
+          LidarDeltaEncoder(opts.quant_step, opts.keyframe_interval));
+    if (opts.multi_rate())
+      sensors.back()->set_rates(opts.imu_rate(), opts.lidar_rate());
+  }
+
+  const double rate = opts.frame_rate();
+  // Under a load test, sleep overshoot at high rates is made up with
+  // back-to-back frames rather than skipped.
+  FrameScheduler clock(rate, opts.spin, opts.overrun,
+                       opts.rate_scale ? 1024 : 3);
+  double scale = 1.0;
+  ChannelDivider imu_due(opts.imu_rate(), rate);
+  ChannelDivider lidar_due(opts.lidar_rate(), rate);
+  const uint64_t log_every = std::max<uint64_t>(1, rate + 0.5);
+  log_info(tag, "Started")
+      .field("vehicles", sensors.size())
+      .field("lidar_points", sensors.front()->lidar_points())
+      .field("lidar", sensors.front()->lidar_source());
+  LogRateLimit tick_limit(Logger::instance().default_rate());
+
+  std::unique_ptr<DiskSpool> recording;
+  if (!opts.record_dir.empty())
+    recording = std::make_unique<DiskSpool>(
+        worker_dir(opts.record_dir, pipe.index, single), 64 << 20, SIZE_MAX);
+
+  auto emit = [&](PacketPtr (SensorSource::*generate)()) {
+    for (auto &sensor : sensors) {
+      PacketPtr packet;
+      {
+        StageTimer timer(Stage::Generate);
+        packet = ((*sensor).*generate)();
+      }
+      if (opts.pre_serialize) {
+        StageTimer timer(Stage::Encode);
+        pre_serialize(packet);
+      }
+      if (recording) {
+        std::string *wire = PacketPool::wire(packet);
+        if (wire && !wire->empty())
+          recording->append(wire->data(), wire->size());
+        else
+          recording->append(*packet);
+      }
+      if (!pipe.queue.push(std::move(packet)))
+        return false;
+    }
+    return true;
+  };
+
+  // Backpressure: while the queue is above its high watermark, halve the
+  // scan resolution (down to 1/8) every half second. Once it has fallen
+  // below the low watermark, double it back every two seconds, so recovery
+  // probes the link more slowly than it sheds load.
+  constexpr int kMaxDegrade = 3;
+  Watermarks watermarks;
+  int degrade = 0;
+  uint64_t last_shift = 0;
+  const uint64_t hold = std::max<uint64_t>(1, rate / 2);
 
+  uint64_t ticks = 0;
   while (running) {
-    auto start = std::chrono::steady_clock::now();
+    if (opts.rate_scale) {
+      double s = opts.rate_scale->load(std::memory_order_relaxed);
+      if (s != scale && s >= 0)
+        clock.set_rate(rate * s);
+      scale = s;
+      if (s < 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        continue;
+      }
+    }
 
-    if (!queue.push(sensor.generate()))
+    bool open;
+    if (!opts.multi_rate()) {
+      open = emit(&SensorSource::generate);
+    } else {
+      // Evaluate both dividers every frame so neither loses its phase.
+      bool imu = imu_due.due();
+      bool lidar = lidar_due.due();
+      open = (!imu || emit(&SensorSource::generate_imu)) &&
+             (!lidar || emit(&SensorSource::generate_lidar));
+    }
+    if (!open)
       break;
+    ++ticks;
+
+    if (opts.degrade_lidar) {
+      bool pressured =
+          watermarks.update(pipe.queue.size(), pipe.queue.capacity());
+      uint64_t wait = pressured ? hold : hold * 4;
+      int target = pressured ? std::min(degrade + 1, kMaxDegrade)
+                             : std::max(degrade - 1, 0);
+      if (target != degrade && ticks - last_shift >= wait) {
+        degrade = target;
+        last_shift = ticks;
+        size_t points = std::max<size_t>(1, opts.lidar_points >> degrade);
+        for (auto &sensor : sensors)
+          sensor->set_lidar_points(points);
+        log_info(tag, pressured ? "LiDAR degraded" : "LiDAR restored")
+            .field("points", points);
+      }
+    }
 
-    if (sensor.tick() % 60 == 0) {
-      std::cout << "[Physics] Tick " << sensor.tick()
-                << " | Queue: " << queue.size() << std::endl;
+    if (ticks % log_every == 0) {
+      auto line = log_info(tag, "Tick", &tick_limit);
+      line.field("tick", ticks)
+          .field("queue", pipe.queue.size())
+          .field("overruns", clock.overruns());
+      if (auto dropped = pipe.queue.dropped())
+        line.field("dropped", dropped);
     }
 
-    auto elapsed = std::chrono::steady_clock::now() - start;
-    std::this_thread::sleep_for(frame - elapsed);
+    clock.wait();
   }
 
-  std::cout << "[Physics] Stopped at tick " << sensor.tick() << std::endl;
+  log_info(tag, "Stopped")
+      .field("tick", ticks)
+      .field("overruns", clock.overruns())
+      .field("skipped", clock.skipped())
+      .field("dropped", pipe.queue.dropped())
+      .field("allocated", pipe.pool.allocated());
 }
 
-void network_thread(ThreadSafeQueue<std::unique_ptr<TelemetryPacket>> &queue,
-                    const std::string &server, bool simulate) {
-  NetworkClient client(server);
+// Streams a recorded session into the pipeline, keeping the original spacing
+// between packets divided by `speed` (0 = as fast as possible). Packets are
+// re-stamped with the send time so latency metrics stay meaningful.
+void replay_thread(Pipeline &pipe, const std::string &path, double speed,
+                   bool encode, StopSignal &stop) {
+  SpoolReader reader(path);
+  {
+    auto line = log_info("Replay");
+    line << path << " (" << reader.segments() << " segments";
+    if (reader.sources() > 1)
+      line << " from " << reader.sources() << " workers";
+    line << ") at ";
+    if (speed > 0)
+      line << speed << "x";
+    else
+      line << "max speed";
+  }
+  LogRateLimit progress_limit(Logger::instance().default_rate());
+
+  auto start = std::chrono::steady_clock::now();
+  int64_t first_ts = -1;
+  uint64_t replayed = 0;
+  auto packet = pipe.pool.acquire();
+  while (running && reader.next(packet.get())) {
+    if (first_ts < 0)
+      first_ts = packet->timestamp();
+    if (speed > 0) {
+      auto offset = std::chrono::microseconds(static_cast<int64_t>(
+          (packet->timestamp() - first_ts) / speed));
+      std::this_thread::sleep_until(start + offset);
+    }
+    stamp_capture_time(packet.get());
+    if (encode) {
+      StageTimer timer(Stage::Encode);
+      pre_serialize(packet);
+    }
+    if (!pipe.queue.push(std::move(packet)))
+      break;
+    packet = pipe.pool.acquire();
+    if (++replayed % 600 == 0)
+      log_info("Replay", "Progress", &progress_limit)
+          .field("packets", replayed);
+  }
+
+  log_info("Replay", "Done").field("packets", replayed);
+  running = false;
+  stop.notify();
+}
+
+struct NetworkOptions {
+  std::string server;
+  bool simulate = true;
+  bool async = false;
+  size_t window = 64;
+  BatchPolicy batch;
+  std::string spool_dir; // Offline buffer for the sync client
+  size_t spool_mb = 4096;
+  ChannelConfig channel;
+  BackoffPolicy backoff;
+  size_t channels = 1; // Per pipeline, each with its own connection
+  RoutePolicy route = RoutePolicy::LeastOutstanding;
+  ThreadTuning *tuning = nullptr; // Registers the threads started below
+};
+
+constexpr size_t kSpoolSegment = 64 << 20;
+
+// Totals of one channel's client.
+struct ChannelTotals {
+  uint64_t sent = 0;
+  uint64_t lost = 0;
+  size_t spooled = 0; // Left in the spool for the next run
+};
 
-  if (simulate) {
-    client.simulate(queue);
-  } else if (client.connect()) {
+// Streams `queue` to the server over the process's `channel_id`-th channel
+// until the queue is closed and drained.
+ChannelTotals stream_channel(PacketQueue &queue, const NetworkOptions &opts,
+                             int channel_id, const std::string &spool_dir,
+                             size_t spool_segments, DrainCancel *cancel,
+                             LinkState *link) {
+  ChannelTotals totals;
+  ChannelConfig channel = opts.channel.for_channel(channel_id);
+  if (opts.async) {
+    AsyncNetworkClient client(opts.server, opts.window, channel, opts.backoff);
+    client.set_drain_cancel(cancel);
+    client.set_link_state(link);
+    client.connect();
     client.stream(queue);
+    totals.sent = client.sent();
+    totals.lost = client.lost();
+    return totals;
+  }
+
+  std::unique_ptr<DiskSpool> spool;
+  if (!spool_dir.empty())
+    spool = std::make_unique<DiskSpool>(spool_dir, kSpoolSegment,
+                                        spool_segments);
+  NetworkClient client(opts.server, opts.batch, spool.get(), channel,
+                       opts.backoff);
+  client.set_drain_cancel(cancel);
+  client.set_link_state(link);
+  client.set_thread_tuning(opts.tuning, static_cast<size_t>(channel_id));
+  // An unreachable server is retried, not replaced by simulation.
+  client.connect();
+  client.stream(queue);
+  totals.sent = client.sent();
+  totals.lost = client.lost();
+  totals.spooled = spool ? spool->size() : 0;
+  return totals;
+}
+
+void network_thread(Pipeline &pipe, const NetworkOptions &opts,
+                    size_t workers, StopSignal &stop) {
+  ChannelTotals totals;
+  const size_t channels = opts.simulate ? 1 : opts.channels;
+  std::string spool_dir;
+  if (!opts.spool_dir.empty() && !opts.async)
+    spool_dir = worker_dir(opts.spool_dir, pipe.index, workers == 1);
+  const size_t spool_segments = std::max<size_t>(
+      1, (opts.spool_mb << 20) / workers / channels / kSpoolSegment);
+
+  if (opts.simulate) {
+    NetworkClient client(opts.server, opts.batch);
+    client.simulate(pipe.queue);
+    totals.sent = client.sent();
+  } else if (channels == 1) {
+    totals = stream_channel(pipe.queue, opts, static_cast<int>(pipe.index),
+                            spool_dir, spool_segments, &pipe.cancel, nullptr);
   } else {
-    client.simulate(queue);
+    // One client thread per channel behind a router on this thread. Client
+    // threads take the network role, one CPU slot each.
+    ChannelRouter router(
+        channels, std::max<size_t>(64, pipe.queue.capacity() / channels),
+        opts.route);
+    std::vector<ChannelTotals> per_channel(channels);
+    std::vector<std::thread> clients;
+    for (size_t c = 0; c < channels; ++c)
+      clients.emplace_back([&, c] {
+        opts.tuning->apply("channel", opts.tuning->network,
+                           pipe.index * channels + c);
+        per_channel[c] = stream_channel(
+            router.queue(c), opts, static_cast<int>(pipe.index * channels + c),
+            spool_dir.empty() ? spool_dir
+                              : spool_dir + "/channel-" + std::to_string(c),
+            spool_segments, &pipe.cancel, router.link(c));
+      });
+    router.route(pipe.queue, &pipe.cancel);
+    for (auto &client : clients)
+      client.join();
+
+    totals.lost = router.lost();
+    for (size_t c = 0; c < channels; ++c) {
+      totals.sent += per_channel[c].sent;
+      totals.lost += per_channel[c].lost;
+      totals.spooled += per_channel[c].spooled;
+      log_info("Network", "Channel")
+          .field("channel", c)
+          .field("routed", router.routed(c))
+          .field("sent", per_channel[c].sent)
+          .field("failures", router.link(c)->failures.load());
+    }
   }
 
-  std::cout << "[Network] Sent " << client.sent() << " packets" << std::endl;
+  pipe.sent = totals.sent;
+  pipe.lost = totals.lost;
+  pipe.spooled = totals.spooled;
+  log_info("Network", "Done").field("sent", totals.sent);
+  pipe.done = true;
+  stop.notify();
+}
+
+void print_usage(std::ostream &out) {
+  out
+      << "Usage: omnistream [--vehicle ID] [--server ADDR] [--real]\n"
+      << "                  [--vehicles N] [--workers M]\n"
+      << "                  [--rate HZ] [--spin-us US]\n"
+      << "                  [--imu-rate HZ] [--lidar-rate HZ]\n"
+      << "                  [--overrun catchup|skip]\n"
+      << "                  [--lidar-points N] [--fixed-lidar-kernel]\n"
+      << "                  [--lidar-encoding float32|delta16]\n"
+      << "                  [--lidar-step-mm MM] [--keyframe-interval N]\n"
+      << "                  [--queue-capacity N] [--degrade-lidar]\n"
+      << "                  [--overflow block|drop-oldest|drop-newest|"
+         "coalesce]\n"
+      << "                  [--pre-serialize]\n"
+      << "                  [--batch N] [--batch-delay-us US]\n"
+      << "                  [--async] [--window N]\n"
+      << "                  [--channels K]\n"
+      << "                  [--route least-outstanding|vehicle-hash]\n"
+      << "                  [--compression none|gzip|deflate]\n"
+      << "                  [--keepalive-ms MS] [--keepalive-timeout-ms MS]\n"
+      << "                  [--max-message-mb MB] [--http2-window-kb KB]\n"
+      << "                  [--write-buffer-kb KB] [--channel-arg K=V]\n"
+      << "                  [--backoff-initial-ms MS] [--backoff-max-ms MS]\n"
+      << "                  [--spool DIR] [--spool-max-mb MB]\n"
+      << "                  [--record DIR]\n"
+      << "                  [--physics-cpus LIST] [--network-cpus LIST]\n"
+      << "                  [--grpc-cpus LIST] [--mlock]\n"
+      << "                  [--physics-sched fifo:P|nice:N]\n"
+      << "                  [--network-sched fifo:P|nice:N]\n"
+      << "                  [--replay PATH] [--replay-speed X]\n"
+      << "                  [--trace PATH] [--trace-format ranges|kitti]\n"
+      << "                  [--trace-points N] [--trace-imu FILE]\n"
+      << "                  [--clock steady|tsc] [--drain-timeout-ms MS]\n"
+      << "                  [--log-level debug|info|warn|error]\n"
+      << "                  [--log-format text|json] [--log-rate N]\n"
+      << "                  [--metrics-interval SEC]\n"
+      << "                  [--load-test] [--load-step-s SEC]\n"
+      << "                  [--load-p99-us US]\n";
 }
 
 int main(int argc, char *argv[]) {
@@ -63,44 +476,473 @@ int main(int argc, char *argv[]) {
             << "========================================\n";
 
   std::string vehicle = "AV-001";
-  std::string server = "localhost:50051";
-  bool simulate = true;
+  size_t vehicles = 1;
+  size_t workers = 1;
+  double metrics_interval = 0.0;
+  size_t queue_capacity = 0; // 0: sized from the vehicle count
+  OverflowPolicy overflow = OverflowPolicy::Block;
+  std::string replay;
+  double replay_speed = 1.0;
+  std::string trace_path, trace_imu;
+  TraceFormat trace_format = TraceFormat::Ranges;
+  size_t trace_points = 0; // 0: --lidar-points
+  ClockSource clock = ClockSource::Steady;
+  auto drain_timeout = std::chrono::milliseconds(2000);
+  Logger::Options log;
+  bool load_test = false;
+  LoadTestOptions load;
+  SensorOptions sensor;
+  NetworkOptions net;
+  net.server = "localhost:50051";
+  ThreadTuning tuning;
+  net.tuning = &tuning;
 
+  const FlagValues value(print_usage);
   for (int i = 1; i < argc; ++i) {
     std::string arg = argv[i];
     if (arg == "--vehicle" && i + 1 < argc)
       vehicle = argv[++i];
+    else if (arg == "--vehicles" && i + 1 < argc)
+      vehicles = std::max<size_t>(1, value.count(arg, argv[++i]));
+    else if (arg == "--workers" && i + 1 < argc)
+      workers = std::max<size_t>(1, value.count(arg, argv[++i]));
+    else if (arg == "--rate" && i + 1 < argc)
+      sensor.rate_hz = std::max(1.0, value.real(arg, argv[++i]));
+    else if (arg == "--imu-rate" && i + 1 < argc)
+      sensor.imu_hz = std::max(1.0, value.real(arg, argv[++i]));
+    else if (arg == "--lidar-rate" && i + 1 < argc)
+      sensor.lidar_hz = std::max(1.0, value.real(arg, argv[++i]));
+    else if (arg == "--spin-us" && i + 1 < argc)
+      sensor.spin = std::chrono::microseconds(value.integer(arg, argv[++i]));
+    else if (arg == "--overrun" && i + 1 < argc)
+      sensor.overrun = std::string(argv[++i]) == "skip"
+                           ? OverrunPolicy::Skip
+                           : OverrunPolicy::CatchUp;
+    else if (arg == "--lidar-points" && i + 1 < argc)
+      sensor.lidar_points = std::max<size_t>(1, value.count(arg, argv[++i]));
+    else if (arg == "--lidar-encoding" && i + 1 < argc) {
+      std::string encoding = argv[++i];
+      sensor.delta_encoding = encoding == "delta16";
+      if (!sensor.delta_encoding && encoding != "float32")
+        std::cerr << "Unknown LiDAR encoding '" << encoding
+                  << "', using float32\n";
+    } else if (arg == "--lidar-step-mm" && i + 1 < argc)
+      // 0.01 mm already limits delta16 to 65535 steps = 0.65 m of range.
+      sensor.quant_step =
+          static_cast<float>(std::max(0.01, value.real(arg, argv[++i]))) /
+          1000.0f;
+    else if (arg == "--keyframe-interval" && i + 1 < argc)
+      sensor.keyframe_interval = static_cast<uint32_t>(std::clamp<size_t>(
+          value.count(arg, argv[++i]), 1, UINT32_MAX));
+    else if (arg == "--queue-capacity" && i + 1 < argc)
+      queue_capacity = std::max<size_t>(1, value.count(arg, argv[++i]));
+    else if (arg == "--overflow" && i + 1 < argc)
+      overflow = parse_overflow_policy(argv[++i]);
+    else if (arg == "--fixed-lidar-kernel")
+      sensor.fixed_kernel = true;
+    else if (arg == "--degrade-lidar")
+      sensor.degrade_lidar = true;
+    else if (arg == "--pre-serialize")
+      sensor.pre_serialize = true;
     else if (arg == "--server" && i + 1 < argc)
-      server = argv[++i];
+      net.server = argv[++i];
+    else if (arg == "--compression" && i + 1 < argc) {
+      if (!net.channel.set_compression(argv[++i]))
+        std::cerr << "Unknown compression '" << argv[i] << "', using none\n";
+    } else if (arg == "--keepalive-ms" && i + 1 < argc)
+      net.channel.keepalive_ms = value.integer(arg, argv[++i]);
+    else if (arg == "--keepalive-timeout-ms" && i + 1 < argc)
+      net.channel.keepalive_timeout_ms = value.integer(arg, argv[++i]);
+    else if (arg == "--max-message-mb" && i + 1 < argc)
+      net.channel.max_message_mb = value.integer(arg, argv[++i]);
+    else if (arg == "--http2-window-kb" && i + 1 < argc)
+      net.channel.http2_window_kb = value.integer(arg, argv[++i]);
+    else if (arg == "--write-buffer-kb" && i + 1 < argc)
+      net.channel.write_buffer_kb = value.integer(arg, argv[++i]);
+    else if (arg == "--channel-arg" && i + 1 < argc) {
+      if (!net.channel.add_arg(argv[++i]))
+        std::cerr << "Ignoring --channel-arg '" << argv[i]
+                  << "' (expected KEY=VALUE)\n";
+    } else if (arg == "--backoff-initial-ms" && i + 1 < argc)
+      net.backoff.initial =
+          std::chrono::milliseconds(std::max(1, value.integer(arg, argv[++i])));
+    else if (arg == "--backoff-max-ms" && i + 1 < argc)
+      net.backoff.max =
+          std::chrono::milliseconds(std::max(1, value.integer(arg, argv[++i])));
     else if (arg == "--real")
-      simulate = false;
+      net.simulate = false;
+    else if (arg == "--async")
+      net.async = true;
+    else if (arg == "--channels" && i + 1 < argc)
+      net.channels = std::max<size_t>(1, value.count(arg, argv[++i]));
+    else if (arg == "--route" && i + 1 < argc) {
+      if (!parse_route_policy(argv[++i], &net.route))
+        std::cerr << "Unknown route '" << argv[i]
+                  << "', using least-outstanding\n";
+    } else if (arg == "--window" && i + 1 < argc)
+      net.window = std::max<size_t>(1, value.count(arg, argv[++i]));
+    else if (arg == "--batch" && i + 1 < argc)
+      net.batch.max_packets = std::max<size_t>(1, value.count(arg, argv[++i]));
+    else if (arg == "--batch-delay-us" && i + 1 < argc)
+      net.batch.max_delay =
+          std::chrono::microseconds(value.integer(arg, argv[++i]));
+    else if (arg == "--spool" && i + 1 < argc)
+      net.spool_dir = argv[++i];
+    else if (arg == "--spool-max-mb" && i + 1 < argc)
+      net.spool_mb = std::max<size_t>(128, value.count(arg, argv[++i]));
+    else if (arg == "--record" && i + 1 < argc)
+      sensor.record_dir = argv[++i];
+    else if (arg == "--replay" && i + 1 < argc)
+      replay = argv[++i];
+    else if (arg == "--replay-speed" && i + 1 < argc)
+      replay_speed = std::max(0.0, value.real(arg, argv[++i]));
+    else if (arg == "--trace" && i + 1 < argc)
+      trace_path = argv[++i];
+    else if (arg == "--trace-format" && i + 1 < argc) {
+      if (!parse_trace_format(argv[++i], &trace_format))
+        std::cerr << "Unknown trace format '" << argv[i]
+                  << "', using ranges\n";
+    } else if (arg == "--trace-points" && i + 1 < argc)
+      trace_points = std::max<size_t>(1, value.count(arg, argv[++i]));
+    else if (arg == "--trace-imu" && i + 1 < argc)
+      trace_imu = argv[++i];
+    else if ((arg == "--physics-cpus" || arg == "--network-cpus" ||
+              arg == "--grpc-cpus") &&
+             i + 1 < argc) {
+      auto &cpus = arg == "--physics-cpus"   ? tuning.physics.cpus
+                   : arg == "--network-cpus" ? tuning.network.cpus
+                                             : tuning.grpc_cpus;
+      if (!parse_cpu_list(argv[++i], &cpus))
+        std::cerr << "Ignoring " << arg << " '" << argv[i]
+                  << "' (expected e.g. 2,4-7)\n";
+    } else if ((arg == "--physics-sched" || arg == "--network-sched") &&
+               i + 1 < argc) {
+      auto &sched = arg == "--physics-sched" ? tuning.physics.sched
+                                             : tuning.network.sched;
+      if (!sched.parse(argv[++i]))
+        std::cerr << "Ignoring " << arg << " '" << argv[i]
+                  << "' (expected fifo:1-99 or nice:-20..19)\n";
+    } else if (arg == "--mlock")
+      tuning.mlock = true;
+    else if (arg == "--clock" && i + 1 < argc)
+      clock = std::string(argv[++i]) == "tsc" ? ClockSource::Tsc
+                                               : ClockSource::Steady;
+    else if (arg == "--drain-timeout-ms" && i + 1 < argc)
+      drain_timeout =
+          std::chrono::milliseconds(std::max(0, value.integer(arg, argv[++i])));
+    else if (arg == "--log-level" && i + 1 < argc) {
+      if (!parse_log_level(argv[++i], &log.level))
+        std::cerr << "Unknown log level '" << argv[i] << "', using info\n";
+    } else if (arg == "--log-format" && i + 1 < argc)
+      log.format = std::string(argv[++i]) == "json" ? LogFormat::Json
+                                                    : LogFormat::Text;
+    else if (arg == "--log-rate" && i + 1 < argc)
+      log.rate = std::max(0.0, value.real(arg, argv[++i]));
+    else if (arg == "--metrics-interval" && i + 1 < argc)
+      metrics_interval = value.real(arg, argv[++i]);
+    else if (arg == "--load-test")
+      load_test = true;
+    else if (arg == "--load-step-s" && i + 1 < argc)
+      load.step = std::chrono::milliseconds(
+          static_cast<int64_t>(std::max(0.5, value.real(arg, argv[++i])) *
+                               1000));
+    else if (arg == "--load-p99-us" && i + 1 < argc)
+      load.p99_us = std::max(1.0, value.real(arg, argv[++i]));
     else if (arg == "--help") {
-      std::cout
-          << "Usage: omnistream [--vehicle ID] [--server ADDR] [--real]\n";
+      print_usage(std::cout);
       return 0;
     }
   }
 
-  std::cout << "Vehicle: " << vehicle << "\n"
-            << "Server:  " << server << "\n"
-            << "Mode:    " << (simulate ? "SIMULATE" : "LIVE") << "\n\n";
+  workers = replay.empty() ? std::min(workers, vehicles) : 1;
+  if (load_test && !replay.empty()) {
+    std::cerr << "Ignoring --load-test with --replay\n";
+    load_test = false;
+  }
+  // delta16 scans are coded against the previous one: dropping any of them
+  // breaks the vehicle's LiDAR until the next keyframe.
+  if (overflow == OverflowPolicy::Coalesce && sensor.delta_encoding) {
+    std::cerr << "coalesce cannot drop delta16 scans; using block\n";
+    overflow = OverflowPolicy::Block;
+  }
+  if (!CaptureClock::use(clock))
+    std::cerr << "No invariant TSC; using steady_clock for timestamps\n";
+  net.backoff.max = std::max(net.backoff.max, net.backoff.initial);
+
+  if (!trace_path.empty()) {
+    auto trace = std::make_shared<TraceFile>();
+    if (!trace->open(trace_path, trace_format,
+                     trace_points ? trace_points : sensor.lidar_points,
+                     trace_imu)) {
+      std::cerr << "Cannot load trace: " << trace->error() << std::endl;
+      return 1;
+    }
+    sensor.trace = trace;
+  }
+
+  std::cout << "Vehicle: " << vehicle_name(vehicle, 0, vehicles);
+  if (vehicles > 1)
+    std::cout << " .. " << vehicle_name(vehicle, vehicles - 1, vehicles);
+  std::cout << "\n"
+            << "Workers: " << workers << " (" << vehicles << " vehicles)\n"
+            << "Server:  " << net.server << "\n"
+            << "Mode:    " << (net.simulate ? "SIMULATE" : "LIVE")
+            << (net.async ? " (async)" : "") << ", compression "
+            << net.channel.compression_name();
+  if (net.channels > 1 && !net.simulate)
+    std::cout << ", " << net.channels << " channels per worker ("
+              << route_policy_name(net.route) << ")";
+  std::cout << "\n"
+            << "Rate:    ";
+  if (sensor.multi_rate())
+    std::cout << "IMU " << sensor.imu_rate() << " Hz, LiDAR "
+              << sensor.lidar_rate() << " Hz";
+  else
+    std::cout << sensor.rate_hz << " Hz";
+  std::cout << " (spin " << sensor.spin.count() << " us, "
+            << (sensor.overrun == OverrunPolicy::Skip ? "skip" : "catch-up")
+            << ")\n"
+            << "LiDAR:   " << sensor.lidar_points << " pts, "
+            << (sensor.delta_encoding ? "delta16" : "float32") << "\n"
+            << "Queue:   " << kPipelineQueueName << ", "
+            << overflow_policy_name(overflow) << " when full\n"
+            << "Encode:  "
+            << (sensor.pre_serialize ? "producer (pre-serialized)" : "network")
+            << "\n"
+            << "Batch:   " << net.batch.max_packets << " pkts / "
+            << net.batch.max_delay.count() << " us\n"
+            << "Clock:   " << CaptureClock::source_name() << "\n";
+  if (load_test)
+    std::cout << "Load:    ramp from x1, "
+              << std::chrono::duration<double>(load.step).count()
+              << " s steps, queue p99 <= " << load.p99_us << " us\n";
+  if (sensor.trace)
+    std::cout << "Trace:   " << trace_path << " ("
+              << sensor.trace->scans() << " scans"
+              << (trace_format == TraceFormat::Kitti ? ", kitti" : "")
+              << (sensor.trace->imu_samples()
+                      ? ", " + std::to_string(sensor.trace->imu_samples()) +
+                            " IMU samples"
+                      : std::string())
+              << ")\n";
+  if (!net.spool_dir.empty())
+    std::cout << "Spool:   " << net.spool_dir << " (" << net.spool_mb
+              << " MB)" << (net.async ? ", ignored with --async" : "") << "\n";
+  if (tuning.enabled()) {
+    auto cpus = [](const std::vector<int> &list) {
+      return list.empty() ? std::string("any") : format_cpu_list(list);
+    };
+    std::cout << "Threads: physics cpus " << cpus(tuning.physics.cpus) << " ("
+              << tuning.physics.sched.name() << "), network cpus "
+              << cpus(tuning.network.cpus) << " ("
+              << tuning.network.sched.name() << "), gRPC cpus "
+              << cpus(tuning.grpc_cpus) << (tuning.mlock ? ", mlock" : "")
+              << "\n";
+  }
+  std::cout << "\n";
+
+  tuning.lock_memory();
+
+  // Before any thread starts, so all of them inherit the blocked signals.
+  StopSignal stop;
+  Logger::instance().start(log);
 
-  std::signal(SIGINT, on_signal);
-  std::signal(SIGTERM, on_signal);
+  // Each worker buffers at least 8 frames for all of its vehicles.
+  const size_t per_worker = (vehicles + workers - 1) / workers;
+  const size_t capacity = queue_capacity
+                              ? queue_capacity
+                              : std::max<size_t>(1000, per_worker * 8);
 
-  ThreadSafeQueue<std::unique_ptr<TelemetryPacket>> queue;
+  // Coalesce may evict a queued LiDAR-only packet when a newer scan of the
+  // same vehicle arrives; packets carrying IMU data are never coalesced.
+  auto same_vehicle_scan = [](const PacketPtr &queued,
+                              const PacketPtr &incoming) {
+    return queued->channel() == TelemetryPacket::CHANNEL_LIDAR &&
+           incoming->channel() == TelemetryPacket::CHANNEL_LIDAR &&
+           queued->vehicle_id() == incoming->vehicle_id();
+  };
 
-  std::thread physics(physics_thread, std::ref(queue), vehicle);
-  std::thread network(network_thread, std::ref(queue), server, simulate);
+  std::vector<std::unique_ptr<Pipeline>> pipelines;
+  for (size_t w = 0; w < workers; ++w) {
+    pipelines.push_back(std::make_unique<Pipeline>(w, capacity));
+    pipelines.back()->pool.reserve(std::max<size_t>(64, per_worker * 2));
+    pipelines.back()->queue.set_overflow(overflow, same_vehicle_scan);
+  }
+  if (pipelines.front()->queue.overflow() != overflow)
+    std::cout << "[Queue] " << overflow_policy_name(overflow)
+              << " needs the mutex queue; using "
+              << overflow_policy_name(pipelines.front()->queue.overflow())
+              << "\n";
+  if (overflow == OverflowPolicy::Coalesce && !sensor.multi_rate())
+    std::cout << "[Queue] coalesce only evicts LiDAR-only packets; combined "
+                 "packets block (use --lidar-rate)\n";
+  for (size_t v = 0; v < vehicles; ++v)
+    pipelines[v % workers]->vehicles.push_back(
+        vehicle_name(vehicle, v, vehicles));
+
+  std::unique_ptr<LoadRamp> ramp;
+  if (load_test) {
+    double per_vehicle = sensor.multi_rate()
+                             ? sensor.imu_rate() + sensor.lidar_rate()
+                             : sensor.rate_hz;
+    LoadRamp::Probe probe;
+    probe.queue_depth = [&] {
+      size_t depth = 0;
+      for (const auto &pipe : pipelines)
+        depth += pipe->queue.size();
+      return depth;
+    };
+    probe.dropped = [&] {
+      uint64_t dropped = 0;
+      for (const auto &pipe : pipelines)
+        dropped += pipe->queue.dropped();
+      return dropped;
+    };
+    ramp = std::make_unique<LoadRamp>(load, sensor.frame_rate(),
+                                      per_vehicle * vehicles, probe);
+    sensor.rate_scale = &ramp->rate_scale();
+  }
+
+  std::vector<std::thread> threads;
+  for (auto &pipe : pipelines) {
+    Pipeline &p = *pipe;
+    if (replay.empty())
+      threads.emplace_back([&, single = workers == 1] {
+        tuning.apply("physics", tuning.physics, p.index);
+        physics_thread(p, sensor, single);
+      });
+    else
+      threads.emplace_back([&] {
+        tuning.apply("replay", tuning.physics, p.index);
+        replay_thread(p, replay, replay_speed, sensor.pre_serialize, stop);
+      });
+    threads.emplace_back([&] {
+      tuning.apply("network", tuning.network, p.index);
+      network_thread(p, net, workers, stop);
+    });
+  }
 
+  // Sleeps until a signal, the end of a replay or load test, or the next
+  // periodic job.
+  using Clock = std::chrono::steady_clock;
+  const auto metrics_period = std::chrono::duration_cast<Clock::duration>(
+      std::chrono::duration<double>(metrics_interval));
+  const auto never = Clock::time_point::max();
+  auto last_dump = Clock::now();
+  auto next_dump = metrics_interval > 0 ? last_dump + metrics_period : never;
+  // gRPC grows its thread pools on demand; keep moving new ones. Sync ack
+  // readers are not waited for: they only start once a stream is open.
+  const size_t registered =
+      threads.size() + (!net.simulate && net.channels > 1
+                            ? pipelines.size() * net.channels
+                            : 0);
+  auto next_sweep = tuning.grpc_cpus.empty() ? never : last_dump;
+  auto next_sample = ramp ? last_dump : never;
   while (running) {
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    auto now = Clock::now();
+    if (now >= next_sample) {
+      if (!ramp->sample(now)) {
+        running = false;
+        break;
+      }
+      next_sample = now + LoadRamp::kSampleInterval;
+    }
+    if (now >= next_sweep) {
+      tuning.pin_foreign(registered);
+      next_sweep = now + std::chrono::seconds(1);
+    }
+    if (now >= next_dump) {
+      std::chrono::duration<double> since = now - last_dump;
+      // One write, so the table is not interleaved with flushed log lines.
+      std::ostringstream table;
+      Metrics::instance().dump(table, since.count());
+      std::cout << table.str() << std::flush;
+      last_dump = now;
+      next_dump = now + metrics_period;
+    }
+    auto next = std::min({next_sweep, next_dump, next_sample});
+    auto event = next == never ? stop.wait() : stop.wait_for(next - now);
+    if (event == StopSignal::Event::Signal) {
+      log_info("Shutdown") << "Shutting down (" << strsignal(stop.last_signal())
+                           << ")";
+      running = false;
+    }
   }
 
-  queue.shutdown();
-  physics.join();
-  network.join();
+  // Bounded drain: producers stop, network threads flush their queues until
+  // the deadline, and any still running then are cancelled, spooling (with
+  // --spool) or dropping the rest. A second signal cancels immediately.
+  // gRPC does not abort a synchronous Write() blocked on flow control, so a
+  // thread still stuck after a grace period is left behind and the process
+  // exits without joining it.
+  constexpr auto kCancelGrace = std::chrono::milliseconds(500);
+  const auto drain_start = Clock::now();
+  size_t queued = 0;
+  for (auto &pipe : pipelines) {
+    queued += pipe->queue.size();
+    pipe->queue.shutdown();
+  }
+  auto drain_until = [&](Clock::time_point deadline) {
+    auto drained = [&] {
+      return std::all_of(pipelines.begin(), pipelines.end(),
+                         [](const auto &pipe) { return pipe->done.load(); });
+    };
+    while (!drained()) {
+      auto now = Clock::now();
+      if (now >= deadline ||
+          stop.wait_for(deadline - now) == StopSignal::Event::Signal)
+        return false;
+    }
+    return true;
+  };
+  const bool cancelled = !drain_until(drain_start + drain_timeout);
+  if (cancelled) {
+    for (auto &pipe : pipelines)
+      pipe->cancel.cancel();
+    if (!drain_until(Clock::now() + kCancelGrace)) {
+      size_t stuck = 0;
+      for (const auto &pipe : pipelines)
+        stuck += pipe->done ? 0 : 1;
+      log_error("Shutdown",
+                "Network threads blocked in a write after cancel; exiting "
+                "without joining")
+          .field("stuck", stuck)
+          .field("queued", queued);
+      Logger::instance().stop();
+      std::_Exit(1);
+    }
+  }
+  for (auto &thread : threads)
+    thread.join();
+
+  uint64_t lost = 0;
+  size_t spooled = 0;
+  for (const auto &pipe : pipelines) {
+    lost += pipe->lost;
+    spooled += pipe->spooled;
+  }
+  auto drain_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                      Clock::now() - drain_start)
+                      .count();
+  log_info("Shutdown", cancelled ? "Drain cancelled" : "Drained")
+      .field("ms", drain_ms)
+      .field("limit_ms", drain_timeout.count())
+      .field("queued", queued)
+      .field("lost", lost)
+      .field("spooled", spooled);
+  Logger::instance().stop();
+
+  if (ramp)
+    ramp->report(std::cout);
+
+  if (workers > 1) {
+    uint64_t total = 0;
+    for (const auto &pipe : pipelines)
+      total += pipe->sent;
+    std::cout << "Total sent: " << total << " packets across " << workers
+              << " workers\n";
+  }
 
   std::cout << "OmniStream stopped.\n";
   return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,223 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+#include "capture_clock.hpp"
+
+namespace omnistream {
+
+// Log-linear latency histogram in the style of HdrHistogram: 32 linear
+// sub-buckets per power of two, so any recorded value is reported within ~3%.
+// Covers 0 ns to ~18 minutes in 1184 buckets. One thread records; any thread
+// may read concurrently, so counts are relaxed atomics without RMW.
+class LatencyHistogram {
+public:
+  static constexpr int kSubBits = 5;
+  static constexpr int kSubBuckets = 1 << kSubBits;
+  static constexpr int kMaxShift = 35;
+  static constexpr size_t kBuckets = kSubBuckets * (kMaxShift + 2);
+
+  void record(int64_t ns) {
+    auto &c = counts_[index(ns < 0 ? 0 : static_cast<uint64_t>(ns))];
+    c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  }
+
+  void add_to(std::vector<uint64_t> &totals) const {
+    for (size_t i = 0; i < kBuckets; ++i)
+      totals[i] += counts_[i].load(std::memory_order_relaxed);
+  }
+
+  static size_t index(uint64_t v) {
+    if (v < kSubBuckets)
+      return static_cast<size_t>(v);
+    int shift = 63 - __builtin_clzll(v) - kSubBits;
+    if (shift > kMaxShift)
+      return kBuckets - 1;
+    return kSubBuckets * (shift + 1) + ((v >> shift) - kSubBuckets);
+  }
+
+  // Upper bound of the values that land in bucket i.
+  static uint64_t upper_bound(size_t i) {
+    if (i < kSubBuckets)
+      return i;
+    uint64_t shift = i / kSubBuckets - 1;
+    uint64_t sub = i % kSubBuckets + kSubBuckets;
+    return ((sub + 1) << shift) - 1;
+  }
+
+private:
+  std::array<std::atomic<uint64_t>, kBuckets> counts_{};
+};
+
+// Pipeline stages with a latency histogram.
+enum class Stage : size_t {
+  Generate,   // SensorGenerator::generate()
+  Encode,     // Producer-side serialization (--pre-serialize)
+  QueueDwell, // Capture timestamp to dequeue on the network thread
+  Write,      // Serialization (unless pre-serialized) plus gRPC write
+  AckRtt,     // Write issued to matching ServerAck (async client)
+  OneWay,     // Capture to server receipt, via the clock offset estimate
+  Count
+};
+
+inline const char *stage_name(Stage stage) {
+  static const char *names[] = {"generate", "encode", "queue", "write",
+                                "ack_rtt", "one_way"};
+  return names[static_cast<size_t>(stage)];
+}
+
+// Process-wide registry of per-thread histograms. Hot threads call
+// Metrics::record(), which touches only the calling thread's histogram;
+// dump() merges all threads and reports the interval since the last dump.
+class Metrics {
+public:
+  static constexpr size_t kStages = static_cast<size_t>(Stage::Count);
+
+  static Metrics &instance() {
+    static Metrics metrics;
+    return metrics;
+  }
+
+  static void record(Stage stage, std::chrono::nanoseconds value) {
+    local(stage).record(value.count());
+  }
+
+  // Cumulative bucket counts per stage, merged over all threads. The
+  // difference of two snapshots is the histogram of the interval between.
+  using Snapshot = std::array<std::vector<uint64_t>, kStages>;
+
+  struct Summary {
+    uint64_t count = 0;
+    double p50 = 0, p99 = 0, p999 = 0, max = 0; // us
+  };
+
+  Snapshot snapshot() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Snapshot snap;
+    for (size_t s = 0; s < kStages; ++s) {
+      snap[s].assign(LatencyHistogram::kBuckets, 0);
+      for (const auto &h : histograms_[s])
+        h->add_to(snap[s]);
+    }
+    return snap;
+  }
+
+  // Count and percentiles of `stage` between two snapshots.
+  static Summary summarize(const Snapshot &from, const Snapshot &to,
+                           Stage stage) {
+    const auto &a = from[static_cast<size_t>(stage)];
+    const auto &b = to[static_cast<size_t>(stage)];
+    std::vector<uint64_t> counts(LatencyHistogram::kBuckets, 0);
+    Summary summary;
+    for (size_t i = 0; i < counts.size(); ++i) {
+      counts[i] = b[i] - (a.empty() ? 0 : a[i]);
+      summary.count += counts[i];
+    }
+    if (summary.count == 0)
+      return summary;
+    summary.p50 = percentile(counts, summary.count, 0.50);
+    summary.p99 = percentile(counts, summary.count, 0.99);
+    summary.p999 = percentile(counts, summary.count, 0.999);
+    summary.max = percentile(counts, summary.count, 1.0);
+    return summary;
+  }
+
+  // Writes p50/p99/p999/max per stage for the interval since the last dump.
+  void dump(std::ostream &out, double interval_s) {
+    Snapshot now = snapshot();
+    char line[160];
+    std::snprintf(line, sizeof(line), "%-10s %10s %10s %9s %9s %9s %9s",
+                  "[Metrics]", "count", "rate/s", "p50 us", "p99 us",
+                  "p999 us", "max us");
+    out << line << "\n";
+
+    for (size_t s = 0; s < kStages; ++s) {
+      Summary summary = summarize(last_, now, static_cast<Stage>(s));
+      if (summary.count == 0)
+        continue;
+      std::snprintf(line, sizeof(line),
+                    "%-10s %10llu %10.1f %9.1f %9.1f %9.1f %9.1f",
+                    stage_name(static_cast<Stage>(s)),
+                    static_cast<unsigned long long>(summary.count),
+                    summary.count / interval_s, summary.p50, summary.p99,
+                    summary.p999, summary.max);
+      out << line << "\n";
+    }
+    last_ = std::move(now);
+    out.flush();
+  }
+
+private:
+  static LatencyHistogram &local(Stage stage) {
+    thread_local std::array<LatencyHistogram *, kStages> slots{};
+    auto *&slot = slots[static_cast<size_t>(stage)];
+    if (!slot)
+      slot = instance().add(stage);
+    return *slot;
+  }
+
+  // Histograms are never freed, so they outlive the threads that record.
+  LatencyHistogram *add(Stage stage) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto &list = histograms_[static_cast<size_t>(stage)];
+    list.push_back(std::make_unique<LatencyHistogram>());
+    return list.back().get();
+  }
+
+  // Value (in us) at quantile q of an interval's bucket counts.
+  static double percentile(const std::vector<uint64_t> &counts,
+                           uint64_t total, double q) {
+    uint64_t rank = static_cast<uint64_t>(q * total);
+    if (rank == 0)
+      rank = 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts.size(); ++i) {
+      seen += counts[i];
+      if (seen >= rank)
+        return LatencyHistogram::upper_bound(i) / 1000.0;
+    }
+    return 0.0;
+  }
+
+  std::mutex mutex_;
+  std::array<std::vector<std::unique_ptr<LatencyHistogram>>, kStages>
+      histograms_;
+  Snapshot last_; // As of the previous dump()
+};
+
+inline int64_t wall_clock_micros() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+// Queue dwell from a packet's monotonic capture time (capture_monotonic).
+inline void record_queue_dwell(int64_t capture_monotonic_us) {
+  Metrics::record(Stage::QueueDwell,
+                  std::chrono::microseconds(CaptureClock::local().now() -
+                                            capture_monotonic_us));
+}
+
+// Records the lifetime of the scope into a stage histogram.
+class StageTimer {
+public:
+  explicit StageTimer(Stage stage)
+      : stage_(stage), start_(std::chrono::steady_clock::now()) {}
+  ~StageTimer() {
+    Metrics::record(stage_, std::chrono::steady_clock::now() - start_);
+  }
+
+private:
+  Stage stage_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+} // namespace omnistream
@@ -1,77 +1,332 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
 #include <iostream>
 #include <memory>
 #include <string>
+#include <thread>
+#include <vector>
 
+#include "channel_config.hpp"
+#include "connection_manager.hpp"
+#include "disk_spool.hpp"
+#include "logger.hpp"
+#include "metrics.hpp"
+#include "packet_queue.hpp"
+#include "shutdown.hpp"
 #include "telemetry.grpc.pb.h"
 #include "telemetry.pb.h"
-#include "thread_safe_queue.hpp"
+#include "thread_tuning.hpp"
+#include "wire_packet.hpp"
 #include <grpcpp/grpcpp.h>
 
 namespace omnistream {
 
+// Write batching for the live stream. Every wakeup drains up to max_packets
+// from the queue, waiting at most max_delay after the first one. All but the
+// last packet are written with buffer_hint so gRPC coalesces them into as few
+// HTTP/2 frames and syscalls as possible; the last write flushes the batch.
+// max_packets = 1 keeps the original one-write-per-packet behaviour.
+struct BatchPolicy {
+  size_t max_packets = 1;
+  std::chrono::microseconds max_delay{0};
+};
+
 // gRPC streaming client that consumes packets from queue and sends to server.
+//
+// A failed stream does not end the session: the ConnectionManager reopens it
+// with jittered exponential backoff. Without a spool the queue backs up
+// meanwhile and its overflow policy decides what is lost. With a DiskSpool
+// attached, the packet whose write failed and everything popped while the
+// server is unreachable go to the spool, and after reconnecting the spooled
+// backlog is streamed ahead of new packets (which are appended behind it)
+// until the spool is empty. Acks are read and discarded on a side thread, so
+// packets still buffered in the transport when the link drops are lost;
+// AsyncNetworkClient resends those.
+//
+// A DrainCancel bounds the drain after queue shutdown: cancelling it fails
+// the current write, and the rest of the queue is spooled (or counted as
+// lost without a spool) instead of waiting for the server.
 class NetworkClient {
 public:
-  explicit NetworkClient(const std::string &address)
-      : address_(address), connected_(false), sent_(0) {}
+  static constexpr auto kConnectTimeout = std::chrono::seconds(2);
+  static constexpr size_t kDrainBurst = 256;
 
+  explicit NetworkClient(const std::string &address, BatchPolicy batch = {},
+                         DiskSpool *spool = nullptr, ChannelConfig config = {},
+                         BackoffPolicy backoff = {})
+      : address_(address), batch_(batch), spool_(spool),
+        config_(std::move(config)), backoff_(backoff), connected_(false),
+        sent_(0) {}
+
+  // Returns whether the server answered within kConnectTimeout; stream()
+  // keeps retrying either way.
   bool connect() {
-    channel_ =
-        grpc::CreateChannel(address_, grpc::InsecureChannelCredentials());
-    stub_ = TelemetryStream::NewStub(channel_);
+    conn_ = std::make_unique<ConnectionManager>(address_, config_, backoff_);
+    conn_->set_link_state(link_);
+    stub_ = std::make_unique<RawTelemetryStub>(conn_->channel());
     connected_ = true;
-    std::cout << "[Network] Connected to " << address_ << std::endl;
-    return true;
+    bool ready = conn_->connect(kConnectTimeout);
+    log_info("Network") << (ready ? "Connected to " : "Waiting for ")
+                        << address_;
+    return ready;
   }
 
-  void stream(ThreadSafeQueue<std::unique_ptr<TelemetryPacket>> &queue) {
+  void stream(PacketQueue &queue) {
     if (!connected_) {
       simulate(queue);
       return;
     }
 
-    grpc::ClientContext ctx;
-    auto stream = stub_->StreamTelemetry(&ctx);
+    while (!run_stream(queue)) {
+      conn_->stream_failed();
+      if (!await_reconnect(queue))
+        break;
+    }
+    if (conn_->reconnects() > 0)
+      log_info("Network", "Reconnects").field("count", conn_->reconnects());
+  }
+
+  void simulate(PacketQueue &queue) {
+    log_info("Network", "Running in simulation mode");
 
     while (auto packet = queue.pop()) {
-      if (!stream->Write(**packet))
-        break;
+      record_queue_dwell((*packet)->capture_monotonic());
       log_progress(queue.size());
     }
 
+    log_info("Network", "Simulation done").field("packets", sent_.load());
+  }
+
+  void set_drain_cancel(DrainCancel *cancel) { cancel_ = cancel; }
+  // Call before connect().
+  void set_link_state(LinkState *link) { link_ = link; }
+  // Registers each stream's ack reader as acks-`index` on the network role,
+  // so the gRPC sweep leaves it alone.
+  void set_thread_tuning(ThreadTuning *tuning, size_t index) {
+    tuning_ = tuning;
+    tuning_index_ = index;
+  }
+
+  uint64_t sent() const { return sent_; }
+  // Packets dropped after a failed write or at shutdown for lack of a spool.
+  uint64_t lost() const { return lost_; }
+
+private:
+  // Raw stream: pre-serialized packets are written without re-encoding.
+  using Stream = RawTelemetryStub::Writer;
+
+  // One RPC. Returns true once the queue is drained and closed, false if
+  // the stream failed first.
+  bool run_stream(PacketQueue &queue) {
+    grpc::ClientContext ctx;
+    config_.apply(ctx);
+    DrainCancel::Scope cancellable(cancel_, &ctx);
+    auto stream = stub_->StreamTelemetry(&ctx);
+    // Acks must be read: once enough are unread the server blocks writing
+    // the next one and stops reading packets. They are only counted, to
+    // publish what is outstanding.
+    std::thread acks([this, &stream] {
+      if (tuning_)
+        tuning_->apply("acks", tuning_->network, tuning_index_);
+      ServerAck ack;
+      while (stream->Read(&ack)) {
+        // This thread is the only one to decrement.
+        if (link_ && link_->outstanding.load(std::memory_order_relaxed) > 0)
+          link_->outstanding.fetch_sub(1, std::memory_order_relaxed);
+      }
+    });
+
+    bool ok = !spool_ || drain_spool(*stream, queue);
+    if (ok && batch_.max_packets > 1) {
+      ok = stream_batched(*stream, queue);
+    } else if (ok) {
+      while (auto packet = queue.pop()) {
+        record_queue_dwell((*packet)->capture_monotonic());
+        took(1);
+        StageTimer timer(Stage::Write);
+        auto bytes = to_byte_buffer(std::move(*packet));
+        if (!stream->Write(bytes)) {
+          spool(bytes);
+          ok = false;
+          break;
+        }
+        conn_->stream_healthy();
+        log_progress(queue.size());
+      }
+    }
+
     stream->WritesDone();
+    acks.join(); // Until the server closes
+    // Anything still unacked was spooled or lost with the stream.
+    if (link_)
+      link_->outstanding.store(0, std::memory_order_relaxed);
     auto status = stream->Finish();
-    std::cout << "[Network] Stream closed: " << status.error_message()
-              << std::endl;
+    auto line = log_info("Network", "Stream closed");
+    if (!status.ok())
+      line.field("status", status.error_message());
+    return ok;
+  }
+
+  // Streams the spooled backlog, moving newly queued packets behind it so
+  // order is preserved. Writes are unpaced, so the backlog drains as fast as
+  // the link allows.
+  bool drain_spool(Stream &stream, PacketQueue &queue) {
+    if (spool_->empty())
+      return true;
+    log_info("Network", "Draining spool").field("packets", spool_->size());
+    const auto buffered = grpc::WriteOptions().set_buffer_hint();
+    while (!spool_->empty()) {
+      while (auto live = queue.try_pop())
+        spool(*live);
+      for (size_t i = 0; i < kDrainBurst && !spool_->empty(); ++i) {
+        bool last = i + 1 == kDrainBurst || spool_->size() == 1;
+        // Spooled records are already serialized; copy them out of the
+        // mapping, which may be gone before gRPC has sent them.
+        auto record = spool_->front();
+        grpc::Slice slice(record.data(), record.size());
+        grpc::ByteBuffer bytes(&slice, 1);
+        took(1);
+        if (!stream.Write(bytes, last ? grpc::WriteOptions() : buffered))
+          return false;
+        spool_->pop_front();
+        conn_->stream_healthy();
+        log_progress(queue.size());
+      }
+    }
+    log_info("Network", "Spool drained");
+    return true;
   }
 
-  void simulate(ThreadSafeQueue<std::unique_ptr<TelemetryPacket>> &queue) {
-    std::cout << "[Network] Running in simulation mode" << std::endl;
+  // Waits for the channel to come back (true). Without a spool, gives up
+  // once the queue is shut down (false); with one, spools popped packets
+  // meanwhile and gives up once the queue is closed and drained.
+  bool await_reconnect(PacketQueue &queue) {
+    if (!spool_) {
+      if (conn_->await_retry([&] { return queue.is_shutdown(); }))
+        return true;
+      while (queue.try_pop())
+        lost_++;
+      log_warn("Network", "Shutdown while disconnected").field("lost", lost_);
+      return false;
+    }
 
-    while (auto packet = queue.pop()) {
-      log_progress(queue.size());
+    log_warn("Network") << "Server unreachable, spooling to " << spool_->dir();
+    bool reconnected = conn_->await_retry([&] {
+      while (auto packet = queue.try_pop())
+        spool(*packet);
+      return queue.closed();
+    });
+    if (reconnected)
+      return true;
+    log_info("Network", "Packets left in spool for the next run")
+        .field("spooled", spool_->size())
+        .field("dropped", spool_->dropped() + spool_failures_);
+    return false;
+  }
+
+  // Counts packets handed to the current stream; the ack reader counts
+  // them off again.
+  void took(size_t n) {
+    if (link_)
+      link_->outstanding.fetch_add(n, std::memory_order_relaxed);
+  }
+
+  void spool(const PacketPtr &packet) {
+    if (!spool_) {
+      lost_++;
+      return;
+    }
+    const std::string *wire = PacketPool::wire(packet);
+    bool ok = wire && !wire->empty()
+                  ? spool_->append(wire->data(), wire->size())
+                  : spool_->append(*packet);
+    if (!ok)
+      spool_failures_++;
+  }
+
+  void spool(const grpc::ByteBuffer &bytes) {
+    if (!spool_) {
+      lost_++;
+      return;
     }
+    grpc::Slice flat;
+    if (!(bytes.DumpToSingleSlice(&flat).ok() &&
+          spool_->append(flat.begin(), flat.size())))
+      spool_failures_++;
+  }
+
+  bool stream_batched(Stream &stream, PacketQueue &queue) {
+    std::vector<PacketPtr> batch;
+    batch.reserve(batch_.max_packets);
+
+    while (auto first = queue.pop()) {
+      record_queue_dwell((*first)->capture_monotonic());
+      took(1);
+      batch.push_back(std::move(*first));
+      auto deadline = std::chrono::steady_clock::now() + batch_.max_delay;
 
-    std::cout << "[Network] Simulation done. Packets: " << sent_ << std::endl;
+      while (batch.size() < batch_.max_packets) {
+        auto next = batch_.max_delay.count() > 0
+                        ? queue.pop_for(deadline -
+                                        std::chrono::steady_clock::now())
+                        : queue.try_pop();
+        if (!next)
+          break;
+        record_queue_dwell((*next)->capture_monotonic());
+        took(1);
+        batch.push_back(std::move(*next));
+      }
+
+      if (!write_batch(stream, batch, queue.size()))
+        return false;
+      batch.clear();
+    }
+    return true;
   }
 
-  uint64_t sent() const { return sent_; }
+  bool write_batch(Stream &stream, std::vector<PacketPtr> &batch,
+                   size_t queue_size) {
+    const auto buffered = grpc::WriteOptions().set_buffer_hint();
+    for (size_t i = 0; i < batch.size(); ++i) {
+      bool last = i + 1 == batch.size();
+      StageTimer timer(Stage::Write);
+      auto bytes = to_byte_buffer(std::move(batch[i]));
+      if (!stream.Write(bytes, last ? grpc::WriteOptions() : buffered)) {
+        spool(bytes);
+        for (++i; i < batch.size(); ++i)
+          spool(batch[i]);
+        return false;
+      }
+      conn_->stream_healthy();
+      log_progress(queue_size);
+    }
+    return true;
+  }
 
-private:
   void log_progress(size_t queue_size) {
     sent_++;
-    if (sent_ % 60 == 0) {
-      std::cout << "[Network] Sent " << sent_ << " | Queue: " << queue_size
-                << std::endl;
-    }
+    if (sent_ % 60 == 0)
+      log_info("Network", "Progress", &progress_limit_)
+          .field("sent", sent_.load())
+          .field("queue", queue_size);
   }
 
   std::string address_;
-  std::shared_ptr<grpc::Channel> channel_;
-  std::unique_ptr<TelemetryStream::Stub> stub_;
+  BatchPolicy batch_;
+  DiskSpool *spool_;
+  ChannelConfig config_;
+  BackoffPolicy backoff_;
+  uint64_t spool_failures_ = 0;
+  uint64_t lost_ = 0;
+  DrainCancel *cancel_ = nullptr;
+  LinkState *link_ = nullptr;
+  ThreadTuning *tuning_ = nullptr;
+  size_t tuning_index_ = 0;
+  LogRateLimit progress_limit_{Logger::instance().default_rate()};
+  std::unique_ptr<ConnectionManager> conn_;
+  std::unique_ptr<RawTelemetryStub> stub_;
   std::atomic<bool> connected_;
   std::atomic<uint64_t> sent_;
 };
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace omnistream {
+
+// What push() does when the queue is full.
+enum class OverflowPolicy {
+  Block,      // Wait for the consumer (default)
+  DropOldest, // Evict the oldest queued item
+  DropNewest, // Discard the item being pushed
+  Coalesce,   // Evict the oldest item the newcomer supersedes; block if
+              // there is none
+};
+
+inline const char *overflow_policy_name(OverflowPolicy policy) {
+  static const char *names[] = {"block", "drop-oldest", "drop-newest",
+                                "coalesce"};
+  return names[static_cast<size_t>(policy)];
+}
+
+// Parses the names above; unknown names fall back to Block.
+inline OverflowPolicy parse_overflow_policy(const std::string &name) {
+  if (name == "drop-oldest")
+    return OverflowPolicy::DropOldest;
+  if (name == "drop-newest")
+    return OverflowPolicy::DropNewest;
+  if (name == "coalesce")
+    return OverflowPolicy::Coalesce;
+  return OverflowPolicy::Block;
+}
+
+// Queue occupancy with hysteresis. The pressured state turns on at or above
+// `high` and off at or below `low` (fractions of capacity), so a producer
+// that adapts to it does not flap around a single threshold.
+class Watermarks {
+public:
+  explicit Watermarks(double low = 0.25, double high = 0.75)
+      : low_(low), high_(high) {}
+
+  // Returns true while the queue is under pressure.
+  bool update(size_t size, size_t capacity) {
+    double fill = capacity ? static_cast<double>(size) / capacity : 0.0;
+    if (fill >= high_)
+      pressured_ = true;
+    else if (fill <= low_)
+      pressured_ = false;
+    return pressured_;
+  }
+
+  bool pressured() const { return pressured_; }
+
+private:
+  double low_;
+  double high_;
+  bool pressured_ = false;
+};
+
+} // namespace omnistream
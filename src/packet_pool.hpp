@@ -0,0 +1,130 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "telemetry.pb.h"
+
+namespace omnistream {
+
+// Recycles TelemetryPacket objects between the network and physics threads.
+// Packets keep their string and repeated-field capacity across uses, so a
+// warmed-up pipeline performs no heap allocation per frame. Packets are handed
+// out as PacketPtr, whose deleter returns them to the pool instead of freeing.
+// Each pooled packet also owns a reusable wire buffer for producer-side
+// serialization (see wire_packet.hpp). The pool must outlive every packet it
+// hands out.
+class PacketPool {
+public:
+  struct Slot {
+    TelemetryPacket packet;
+    std::string wire; // Serialized packet, empty unless pre-encoded
+    PacketPool *pool;
+  };
+
+  struct Recycler {
+    Slot *slot = nullptr;
+
+    void operator()(TelemetryPacket *packet) const {
+      if (slot)
+        slot->pool->release(slot);
+      else
+        delete packet;
+    }
+  };
+
+  using Ptr = std::unique_ptr<TelemetryPacket, Recycler>;
+
+  // Wire buffer of a pooled packet; nullptr for packets made outside a pool.
+  static std::string *wire(const Ptr &packet) {
+    auto *slot = packet.get_deleter().slot;
+    return slot ? &slot->wire : nullptr;
+  }
+
+  explicit PacketPool(size_t max_idle = 1024) : max_idle_(max_idle) {
+    idle_.reserve(max_idle_);
+  }
+
+  ~PacketPool() {
+    for (auto *slot : idle_)
+      delete slot;
+  }
+
+  PacketPool(const PacketPool &) = delete;
+  PacketPool &operator=(const PacketPool &) = delete;
+
+  // Pre-allocates packets so the first frames do not hit the allocator.
+  void reserve(size_t count) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    while (idle_.size() < count && idle_.size() < max_idle_) {
+      idle_.push_back(new Slot{{}, {}, this});
+      allocated_++;
+    }
+  }
+
+  Ptr acquire() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!idle_.empty()) {
+        auto *slot = idle_.back();
+        idle_.pop_back();
+        return Ptr(&slot->packet, Recycler{slot});
+      }
+    }
+    allocated_++;
+    auto *slot = new Slot{{}, {}, this};
+    return Ptr(&slot->packet, Recycler{slot});
+  }
+
+  // Packets ever allocated by this pool; stays flat once the pipeline is warm.
+  uint64_t allocated() const { return allocated_; }
+
+  size_t idle() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return idle_.size();
+  }
+
+private:
+  void release(Slot *slot) {
+    reset(&slot->packet);
+    slot->wire.clear();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (idle_.size() < max_idle_) {
+        idle_.push_back(slot);
+        return;
+      }
+    }
+    delete slot;
+  }
+
+  // Field-wise reset. TelemetryPacket::Clear() would free the IMU submessage,
+  // so clear each field in place and keep the allocations.
+  static void reset(TelemetryPacket *packet) {
+    packet->clear_vehicle_id();
+    packet->clear_timestamp();
+    packet->mutable_lidar_scan()->Clear();
+    packet->mutable_imu_reading()->Clear();
+    packet->clear_battery_level();
+    packet->clear_lidar_encoding();
+    packet->mutable_lidar_quantized()->Clear();
+    packet->clear_lidar_quant_step();
+    packet->clear_lidar_keyframe();
+    packet->clear_lidar_sequence();
+    packet->clear_channel();
+    packet->clear_capture_monotonic();
+    packet->clear_wall_offset();
+  }
+
+  const size_t max_idle_;
+  std::vector<Slot *> idle_;
+  mutable std::mutex mutex_;
+  std::atomic<uint64_t> allocated_{0};
+};
+
+using PacketPtr = PacketPool::Ptr;
+
+} // namespace omnistream
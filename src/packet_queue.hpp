@@ -0,0 +1,27 @@
+#pragma once
+
+#include "packet_pool.hpp"
+#include "telemetry_batch.hpp"
+
+#ifdef OMNISTREAM_LOCKFREE_QUEUE
+#include "spsc_ring_buffer.hpp"
+#else
+#include "thread_safe_queue.hpp"
+#endif
+
+namespace omnistream {
+
+// Queue connecting the physics producer to the network consumer. Selected at
+// compile time: -DOMNISTREAM_LOCKFREE_QUEUE=ON swaps in the SPSC ring buffer.
+#ifdef OMNISTREAM_LOCKFREE_QUEUE
+template <typename T> using PipelineQueue = SpscRingBuffer<T>;
+inline constexpr const char *kPipelineQueueName = "SPSC ring";
+#else
+template <typename T> using PipelineQueue = ThreadSafeQueue<T>;
+inline constexpr const char *kPipelineQueueName = "mutex";
+#endif
+
+using PacketQueue = PipelineQueue<PacketPtr>;
+using BatchQueue = PipelineQueue<TelemetryBatch>;
+
+} // namespace omnistream
@@ -2,75 +2,166 @@
 
 #include <chrono>
 #include <cmath>
+#include <cstddef>
 #include <memory>
+#include <optional>
 #include <string>
-#include <vector>
 
+#include "lidar_codec.hpp"
+#include "lidar_kernel.hpp"
+#include "packet_pool.hpp"
+#include "sensor_source.hpp"
 #include "telemetry.pb.h"
 
 namespace omnistream {
 
 // Generates synthetic sensor data mimicking an autonomous vehicle.
-// Uses pre-allocated buffers to avoid memory churn in the hot loop.
-class SensorGenerator {
+// Writes LiDAR scans straight into the packet through a vectorized kernel;
+// when given a PacketPool, packets are recycled instead of allocated per tick.
+// set_rates() keeps the simulated motion in real time.
+//
+// Kernel is LidarWaveKernel for any resolution (SensorGenerator), or a
+// FixedLidarWaveKernel<N> with compile-time tables (FixedSensorGenerator<N>);
+// make_sensor_generator() picks one.
+template <typename Kernel> class BasicSensorGenerator : public SensorSource {
 public:
-  SensorGenerator(const std::string &vehicle_id, size_t lidar_points = 1024)
-      : vehicle_id_(vehicle_id), lidar_points_(lidar_points), tick_(0),
-        battery_(100.0f) {
-    lidar_buffer_.reserve(lidar_points_);
-  }
+  // Rate the waveform constants were tuned for.
+  static constexpr double kNominalHz = 60.0;
 
-  std::unique_ptr<TelemetryPacket> generate() {
-    auto packet = std::make_unique<TelemetryPacket>();
-
-    packet->set_vehicle_id(vehicle_id_);
-    packet->set_timestamp(now_micros());
+  BasicSensorGenerator(const std::string &vehicle_id,
+                       size_t lidar_points = 1024, PacketPool *pool = nullptr)
+      : vehicle_id_(vehicle_id), lidar_points_(lidar_points), tick_(0),
+        battery_(100.0f), pool_(pool), lidar_kernel_(lidar_points) {}
 
+  PacketPtr generate() override {
+    auto packet = start_packet(TelemetryPacket::CHANNEL_COMBINED);
     fill_lidar(packet.get());
     fill_imu(packet.get());
+    tick_++;
+    imu_tick_++;
+    return packet;
+  }
 
-    battery_ = std::max(0.0f, battery_ - 0.0001f);
-    packet->set_battery_level(battery_);
+  // IMU sample and battery level only.
+  PacketPtr generate_imu() override {
+    auto packet = start_packet(TelemetryPacket::CHANNEL_IMU);
+    fill_imu(packet.get());
+    imu_tick_++;
+    return packet;
+  }
 
+  // LiDAR scan only.
+  PacketPtr generate_lidar() override {
+    auto packet = start_packet(TelemetryPacket::CHANNEL_LIDAR);
+    fill_lidar(packet.get());
     tick_++;
     return packet;
   }
 
-  uint64_t tick() const { return tick_; }
+  // Scales the per-sample waveform and battery steps so motion does not
+  // speed up with the rate.
+  void set_rates(double imu_hz, double lidar_hz) override {
+    imu_scale_ = kNominalHz / imu_hz;
+    lidar_scale_ = kNominalHz / lidar_hz;
+  }
 
-private:
-  void fill_lidar(TelemetryPacket *pkt) {
-    lidar_buffer_.clear();
+  void set_lidar_encoder(const LidarDeltaEncoder &encoder) override {
+    lidar_encoder_ = encoder;
+  }
 
-    for (size_t i = 0; i < lidar_points_; ++i) {
-      float angle = static_cast<float>(i) / lidar_points_ * 2.0f * M_PI;
-      float dist = 10.0f + std::sin(tick_ * 0.05f + angle * 4.0f) * 2.0f;
-      lidar_buffer_.push_back(dist);
-    }
+  // The delta encoder starts a new keyframe when the scan length changes.
+  void set_lidar_points(size_t points) override {
+    if (points == lidar_points_)
+      return;
+    lidar_points_ = points;
+    lidar_kernel_ = Kernel(points);
+  }
+
+  uint64_t tick() const override { return tick_; }
+  uint64_t imu_tick() const { return imu_tick_; }
+  size_t lidar_points() const override { return lidar_points_; }
+  const char *lidar_source() const override { return lidar_kernel_.name(); }
+
+private:
+  PacketPtr start_packet(TelemetryPacket::SensorChannel channel) {
+    auto packet = pool_ ? pool_->acquire() : PacketPtr(new TelemetryPacket());
+    packet->set_vehicle_id(vehicle_id_);
+    stamp_capture_time(packet.get());
+    packet->set_channel(channel);
+    return packet;
+  }
 
-    pkt->mutable_lidar_scan()->Add(lidar_buffer_.begin(), lidar_buffer_.end());
+  // dist = 10 + 2 * sin(tick * 0.05 + angle * 4), angle in [0, 2pi).
+  void fill_lidar(TelemetryPacket *pkt) {
+    int points = static_cast<int>(lidar_points_);
+    auto *scan = pkt->mutable_lidar_scan();
+    scan->Clear();
+    scan->Reserve(points);
+    lidar_kernel_.synthesize(tick_ * 0.05 * lidar_scale_, 10.0f, 2.0f,
+                             scan->AddNAlreadyReserved(points));
+    if (lidar_encoder_)
+      lidar_encoder_->encode(pkt);
   }
 
   void fill_imu(TelemetryPacket *pkt) {
-    float t = tick_ * 0.02f;
+    float t = static_cast<float>(imu_tick_ * 0.02 * imu_scale_);
     auto *imu = pkt->mutable_imu_reading();
     imu->set_accel_x(std::sin(t) * 0.5f);
     imu->set_accel_y(std::cos(t * 0.7f) * 0.3f);
     imu->set_accel_z(9.81f + std::sin(t * 2.0f) * 0.1f);
-  }
 
-  int64_t now_micros() {
-    auto now = std::chrono::system_clock::now();
-    return std::chrono::duration_cast<std::chrono::microseconds>(
-               now.time_since_epoch())
-        .count();
+    battery_ = std::max(0.0f, battery_ - 0.0001f * static_cast<float>(
+                                              imu_scale_));
+    pkt->set_battery_level(battery_);
   }
 
   std::string vehicle_id_;
   size_t lidar_points_;
-  uint64_t tick_;
+  uint64_t tick_;      // LiDAR scans
+  uint64_t imu_tick_ = 0;
+  double imu_scale_ = 1.0;
+  double lidar_scale_ = 1.0;
   float battery_;
-  std::vector<float> lidar_buffer_;
+  PacketPool *pool_;
+  Kernel lidar_kernel_;
+  std::optional<LidarDeltaEncoder> lidar_encoder_;
+};
+
+using SensorGenerator = BasicSensorGenerator<LidarWaveKernel>;
+template <size_t N>
+using FixedSensorGenerator = BasicSensorGenerator<FixedLidarWaveKernel<N>>;
+
+// Resolutions with a compile-time generator. Each one costs a pair of
+// constexpr tables in the binary, so keep this to the production configs.
+struct FixedResolution {
+  size_t points;
+  std::unique_ptr<SensorSource> (*make)(const std::string &, PacketPool *);
 };
 
+template <size_t N>
+std::unique_ptr<SensorSource> make_fixed_generator(const std::string &id,
+                                                   PacketPool *pool) {
+  return std::make_unique<FixedSensorGenerator<N>>(id, N, pool);
+}
+
+inline constexpr FixedResolution kFixedResolutions[] = {
+    {512, make_fixed_generator<512>},
+    {1024, make_fixed_generator<1024>},
+    {2048, make_fixed_generator<2048>},
+    {4096, make_fixed_generator<4096>},
+};
+
+// The dynamic SensorGenerator, or with `fixed` a FixedSensorGenerator when
+// `lidar_points` is in kFixedResolutions. The fixed path is opt-in: it only
+// runs at parity with the dynamic kernel so far (BM_GenerateFixed).
+inline std::unique_ptr<SensorSource>
+make_sensor_generator(const std::string &id, size_t lidar_points,
+                      PacketPool *pool = nullptr, bool fixed = false) {
+  if (fixed)
+    for (const auto &res : kFixedResolutions)
+      if (res.points == lidar_points)
+        return res.make(id, pool);
+  return std::make_unique<SensorGenerator>(id, lidar_points, pool);
+}
+
 } // namespace omnistream
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "capture_clock.hpp"
+#include "lidar_codec.hpp"
+#include "packet_pool.hpp"
+
+namespace omnistream {
+
+// Stamps a packet with the calling thread's capture clock: monotonic
+// capture time, the wall offset, and the wall-clock timestamp they add to.
+inline void stamp_capture_time(TelemetryPacket *packet) {
+  CaptureClock &clock = CaptureClock::local();
+  int64_t now = clock.now(), offset = clock.wall_offset();
+  packet->set_capture_monotonic(now);
+  packet->set_wall_offset(offset);
+  packet->set_timestamp(now + offset);
+}
+
+// Where a physics worker's packets come from: SensorGenerator synthesizes
+// them, TraceSource plays back a recorded LiDAR/IMU log.
+//
+// generate() emits one combined packet per tick. generate_imu() and
+// generate_lidar() emit single-channel packets so each sensor can run on its
+// own schedule.
+class SensorSource {
+public:
+  virtual ~SensorSource() = default;
+
+  virtual PacketPtr generate() = 0;
+  virtual PacketPtr generate_imu() = 0;
+  virtual PacketPtr generate_lidar() = 0;
+
+  // Sample rates of the IMU and LiDAR channels, for sources whose output
+  // depends on elapsed time rather than on the sample count.
+  virtual void set_rates(double imu_hz, double lidar_hz) = 0;
+
+  // Emit LiDAR scans in the compact LIDAR_DELTA_Q16 wire format.
+  virtual void set_lidar_encoder(const LidarDeltaEncoder &encoder) = 0;
+
+  // Changes the scan resolution, e.g. to shed load under backpressure.
+  virtual void set_lidar_points(size_t points) = 0;
+
+  virtual uint64_t tick() const = 0;
+  virtual size_t lidar_points() const = 0;
+  // Short description of how scans are produced, for the startup log.
+  virtual const char *lidar_source() const = 0;
+};
+
+} // namespace omnistream
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+#include <poll.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <unistd.h>
+
+#include <grpcpp/grpcpp.h>
+
+namespace omnistream {
+
+// Shutdown requests without polling or signal handlers. The constructor
+// blocks SIGINT and SIGTERM in the calling thread, so every thread started
+// afterwards (including gRPC's) inherits the mask and the signals are only
+// consumed by wait(), from a signalfd. Other threads wake the waiter with
+// notify(), e.g. when a replay ends. Construct in main() before any thread.
+class StopSignal {
+public:
+  enum class Event { Timeout, Signal, Notify };
+
+  StopSignal() {
+    sigemptyset(&mask_);
+    sigaddset(&mask_, SIGINT);
+    sigaddset(&mask_, SIGTERM);
+    // A background job from a non-interactive shell starts with SIGINT
+    // ignored, and an ignored signal may be discarded before it reaches
+    // the signalfd.
+    std::signal(SIGINT, SIG_DFL);
+    std::signal(SIGTERM, SIG_DFL);
+    pthread_sigmask(SIG_BLOCK, &mask_, nullptr);
+    signal_fd_ = signalfd(-1, &mask_, SFD_CLOEXEC);
+    notify_fd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (signal_fd_ < 0) {
+      // Keep the default actions so the process can still be stopped.
+      std::cerr << "[Shutdown] signalfd: " << std::strerror(errno)
+                << std::endl;
+      pthread_sigmask(SIG_UNBLOCK, &mask_, nullptr);
+    }
+  }
+
+  ~StopSignal() {
+    if (signal_fd_ >= 0)
+      close(signal_fd_);
+    if (notify_fd_ >= 0)
+      close(notify_fd_);
+  }
+
+  StopSignal(const StopSignal &) = delete;
+  StopSignal &operator=(const StopSignal &) = delete;
+
+  // Waits for a signal or notify(), or until `timeout` has passed.
+  template <typename Rep, typename Period>
+  Event wait_for(std::chrono::duration<Rep, Period> timeout) {
+    auto ms = std::chrono::ceil<std::chrono::milliseconds>(timeout).count();
+    return wait(static_cast<int>(std::max<decltype(ms)>(0, ms)));
+  }
+
+  // timeout_ms < 0 waits indefinitely.
+  Event wait(int timeout_ms = -1) {
+    pollfd fds[2] = {{signal_fd_, POLLIN, 0}, {notify_fd_, POLLIN, 0}};
+    if (poll(fds, 2, timeout_ms) <= 0)
+      return Event::Timeout;
+    if (fds[0].revents & POLLIN) {
+      signalfd_siginfo info;
+      if (read(signal_fd_, &info, sizeof(info)) == sizeof(info))
+        last_signal_ = static_cast<int>(info.ssi_signo);
+      return Event::Signal;
+    }
+    uint64_t count;
+    if (read(notify_fd_, &count, sizeof(count)) < 0)
+      return Event::Timeout;
+    return Event::Notify;
+  }
+
+  // Wakes wait(). Safe from any thread.
+  void notify() {
+    uint64_t one = 1;
+    if (write(notify_fd_, &one, sizeof(one)) < 0) {
+      // Only fails if the counter would overflow; a wakeup is pending anyway.
+    }
+  }
+
+  int last_signal() const { return last_signal_; }
+
+private:
+  sigset_t mask_;
+  int signal_fd_ = -1;
+  int notify_fd_ = -1;
+  int last_signal_ = 0;
+};
+
+// Lets the main thread abandon a network client's drain. cancel() marks the
+// drain cancelled and cancels the client's current RPC, which also unblocks
+// a synchronous Write() or Finish() stuck behind a slow server; the client
+// then spools or drops what is left instead of reconnecting. One DrainCancel
+// may cover several clients, e.g. the channels behind a ChannelRouter.
+class DrainCancel {
+public:
+  // Registers a client's RPC for cancel() while in scope. `cancel` may be
+  // null for clients without a shutdown deadline.
+  class Scope {
+  public:
+    Scope(DrainCancel *cancel, grpc::ClientContext *ctx)
+        : cancel_(cancel), ctx_(ctx) {
+      if (cancel_)
+        cancel_->attach(ctx_);
+    }
+    ~Scope() {
+      if (cancel_)
+        cancel_->detach(ctx_);
+    }
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+
+  private:
+    DrainCancel *cancel_;
+    grpc::ClientContext *ctx_;
+  };
+
+  void cancel() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    cancelled_ = true;
+    for (grpc::ClientContext *ctx : contexts_)
+      ctx->TryCancel();
+  }
+
+  bool cancelled() const { return cancelled_; }
+
+private:
+  void attach(grpc::ClientContext *ctx) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    contexts_.push_back(ctx);
+    if (cancelled_)
+      ctx->TryCancel();
+  }
+
+  void detach(grpc::ClientContext *ctx) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    contexts_.erase(std::find(contexts_.begin(), contexts_.end(), ctx));
+  }
+
+  std::mutex mutex_;
+  std::atomic<bool> cancelled_{false};
+  std::vector<grpc::ClientContext *> contexts_;
+};
+
+} // namespace omnistream
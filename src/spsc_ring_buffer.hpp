@@ -0,0 +1,224 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <new>
+#include <optional>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include "overflow_policy.hpp"
+
+namespace omnistream {
+
+inline constexpr size_t kCacheLineSize = 64;
+
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+  _mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+  asm volatile("yield");
+#endif
+}
+
+// Escalating wait used by the blocking paths: spin, then yield, then sleep.
+// Keeps the hot handoff in user space while bounding CPU burn when idle.
+class Backoff {
+public:
+  void pause() {
+    if (spins_ < kSpinLimit) {
+      cpu_relax();
+    } else if (spins_ < kYieldLimit) {
+      std::this_thread::yield();
+    } else {
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+    spins_++;
+  }
+
+  void reset() { spins_ = 0; }
+
+private:
+  static constexpr unsigned kSpinLimit = 256;
+  static constexpr unsigned kYieldLimit = kSpinLimit + 64;
+  unsigned spins_ = 0;
+};
+
+// Bounded single-producer/single-consumer ring buffer with the same
+// push/pop/shutdown/size API as ThreadSafeQueue. Exactly one thread may push
+// and one thread may pop. Producer and consumer indices sit on separate cache
+// lines and each side caches the other's index, so an uncontended handoff is
+// one release store and no shared writes.
+//
+// Only the consumer may remove items, so the producer cannot evict: every
+// overflow policy other than Block behaves as DropNewest here.
+template <typename T> class SpscRingBuffer {
+public:
+  using Coalescible = std::function<bool(const T &, const T &)>;
+
+  explicit SpscRingBuffer(size_t capacity = 1000)
+      : capacity_(capacity), mask_(round_up_pow2(capacity) - 1),
+        slots_(new Slot[mask_ + 1]) {}
+
+  ~SpscRingBuffer() {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    for (size_t i = head_.load(std::memory_order_relaxed); i != tail; ++i)
+      slot(i)->~T();
+  }
+
+  SpscRingBuffer(const SpscRingBuffer &) = delete;
+  SpscRingBuffer &operator=(const SpscRingBuffer &) = delete;
+
+  // Call before the queue is shared.
+  void set_overflow(OverflowPolicy policy, Coalescible = {}) {
+    drop_when_full_ = policy != OverflowPolicy::Block;
+  }
+
+  // Policy in effect after the fallback described above.
+  OverflowPolicy overflow() const {
+    return drop_when_full_ ? OverflowPolicy::DropNewest : OverflowPolicy::Block;
+  }
+
+  // Returns false only after shutdown; a dropped item still counts as pushed.
+  bool push(T item) {
+    Backoff backoff;
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+
+    while (tail - cached_head_ >= capacity_) {
+      if (shutdown_.load(std::memory_order_acquire))
+        return false;
+      cached_head_ = head_.load(std::memory_order_acquire);
+      if (tail - cached_head_ < capacity_)
+        break;
+      if (drop_when_full_) {
+        dropped_.store(dropped_.load(std::memory_order_relaxed) + 1,
+                       std::memory_order_relaxed);
+        return true;
+      }
+      backoff.pause();
+    }
+
+    if (shutdown_.load(std::memory_order_acquire))
+      return false;
+
+    new (slot(tail)) T(std::move(item));
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  std::optional<T> pop() { return pop_until(nullptr); }
+
+  // Non-blocking pop; empty optional if nothing is queued.
+  std::optional<T> try_pop() {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    if (head == cached_tail_) {
+      cached_tail_ = tail_.load(std::memory_order_acquire);
+      if (head == cached_tail_)
+        return std::nullopt;
+    }
+    return take(head);
+  }
+
+  // Blocking pop bounded by timeout; empty optional on timeout or shutdown.
+  template <typename Rep, typename Period>
+  std::optional<T> pop_for(std::chrono::duration<Rep, Period> timeout) {
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    return pop_until(&deadline);
+  }
+
+  void shutdown() { shutdown_.store(true, std::memory_order_release); }
+
+  size_t size() const {
+    size_t head = head_.load(std::memory_order_acquire);
+    return tail_.load(std::memory_order_acquire) - head;
+  }
+
+  size_t capacity() const { return capacity_; }
+
+  uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+  bool is_shutdown() const {
+    return shutdown_.load(std::memory_order_acquire);
+  }
+
+  // True once shutdown() was called and every queued item has been popped.
+  // Consumer side only.
+  bool closed() const {
+    return shutdown_.load(std::memory_order_acquire) &&
+           head_.load(std::memory_order_relaxed) ==
+               tail_.load(std::memory_order_acquire);
+  }
+
+private:
+  struct alignas(T) Slot {
+    unsigned char bytes[sizeof(T)];
+  };
+
+  std::optional<T>
+  pop_until(const std::chrono::steady_clock::time_point *deadline) {
+    Backoff backoff;
+    const size_t head = head_.load(std::memory_order_relaxed);
+
+    while (head == cached_tail_) {
+      cached_tail_ = tail_.load(std::memory_order_acquire);
+      if (head != cached_tail_)
+        break;
+      if (shutdown_.load(std::memory_order_acquire)) {
+        // Re-check after observing shutdown so a final push is not lost.
+        cached_tail_ = tail_.load(std::memory_order_acquire);
+        if (head == cached_tail_)
+          return std::nullopt;
+        break;
+      }
+      if (deadline && std::chrono::steady_clock::now() >= *deadline)
+        return std::nullopt;
+      backoff.pause();
+    }
+
+    return take(head);
+  }
+
+  std::optional<T> take(size_t head) {
+    T *p = slot(head);
+    std::optional<T> item(std::move(*p));
+    p->~T();
+    head_.store(head + 1, std::memory_order_release);
+    return item;
+  }
+
+  static size_t round_up_pow2(size_t n) {
+    size_t p = 1;
+    while (p < n)
+      p <<= 1;
+    return p;
+  }
+
+  T *slot(size_t index) {
+    return std::launder(reinterpret_cast<T *>(slots_[index & mask_].bytes));
+  }
+
+  // Read-only after construction.
+  const size_t capacity_;
+  const size_t mask_;
+  std::unique_ptr<Slot[]> slots_;
+  bool drop_when_full_ = false;
+  std::atomic<bool> shutdown_{false};
+
+  // Consumer-owned.
+  alignas(kCacheLineSize) std::atomic<size_t> head_{0};
+  size_t cached_tail_ = 0;
+
+  // Producer-owned.
+  alignas(kCacheLineSize) std::atomic<size_t> tail_{0};
+  size_t cached_head_ = 0;
+  std::atomic<uint64_t> dropped_{0};
+};
+
+} // namespace omnistream
@@ -0,0 +1,227 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "telemetry.pb.h"
+
+namespace omnistream {
+
+// Fixed-size array on a 64-byte boundary, for columns that SIMD loops read
+// with aligned loads. Zero-initialized.
+template <typename T> class AlignedArray {
+public:
+  static constexpr size_t kAlignment = 64;
+
+  AlignedArray() = default;
+  explicit AlignedArray(size_t n) : size_(n) {
+    if (n == 0)
+      return;
+    size_t bytes = (n * sizeof(T) + kAlignment - 1) & ~(kAlignment - 1);
+    data_.reset(static_cast<T *>(std::aligned_alloc(kAlignment, bytes)));
+    if (!data_)
+      throw std::bad_alloc();
+    std::memset(data_.get(), 0, bytes);
+  }
+
+  T *data() { return data_.get(); }
+  const T *data() const { return data_.get(); }
+  T &operator[](size_t i) { return data_.get()[i]; }
+  const T &operator[](size_t i) const { return data_.get()[i]; }
+  size_t size() const { return size_; }
+
+private:
+  struct Free {
+    void operator()(T *p) const { std::free(p); }
+  };
+
+  std::unique_ptr<T, Free> data_;
+  size_t size_ = 0;
+};
+
+// N telemetry frames in columnar form: one contiguous column per scalar
+// field and a 2D LiDAR block with one row per frame. Every column, and
+// every LiDAR row, starts on a 64-byte boundary (rows are padded to a
+// multiple of 16 floats), so loops over a column or a row vectorize with
+// aligned loads and no gathers from scattered protobuf objects.
+//
+// Frames keep their channel: an IMU-only frame has no LiDAR points, and a
+// LiDAR-only frame leaves the IMU columns at zero. Scans shorter than the
+// row (e.g. while resolution is degraded) record their own length; the
+// rest of the row is +inf, so min-style kernels can run whole rows.
+//
+// Movable and default-constructible, so PipelineQueue<TelemetryBatch> works
+// like the packet queue. Not thread-safe.
+class TelemetryBatch {
+public:
+  static constexpr size_t kRowAlignFloats =
+      AlignedArray<float>::kAlignment / sizeof(float);
+
+  TelemetryBatch() = default;
+  TelemetryBatch(size_t capacity, size_t lidar_points)
+      : capacity_(capacity),
+        stride_((lidar_points + kRowAlignFloats - 1) / kRowAlignFloats *
+                kRowAlignFloats),
+        timestamp_(capacity), capture_monotonic_(capacity),
+        wall_offset_(capacity), accel_x_(capacity), accel_y_(capacity),
+        accel_z_(capacity), battery_(capacity), channel_(capacity),
+        vehicle_(capacity), lidar_points_(capacity),
+        lidar_(capacity * stride_) {}
+
+  TelemetryBatch(TelemetryBatch &&) noexcept = default;
+  TelemetryBatch &operator=(TelemetryBatch &&) noexcept = default;
+
+  size_t size() const { return size_; }
+  size_t capacity() const { return capacity_; }
+  bool full() const { return size_ == capacity_; }
+  bool empty() const { return size_ == 0; }
+  // Floats per LiDAR row, including padding.
+  size_t lidar_stride() const { return stride_; }
+
+  void clear() {
+    size_ = 0;
+    vehicle_ids_.clear();
+  }
+
+  // Appends one packet. Float32 scans are copied from the packet;
+  // LIDAR_DELTA_Q16 packets need the decoded ranges in `scan` (see
+  // LidarDeltaDecoder), otherwise the frame is stored without LiDAR.
+  // Returns false if the batch is full or the scan is longer than a row.
+  bool append(const TelemetryPacket &packet,
+              const std::vector<float> *scan = nullptr) {
+    const float *ranges = nullptr;
+    size_t n = 0;
+    if (packet.channel() != TelemetryPacket::CHANNEL_IMU) {
+      if (scan) {
+        ranges = scan->data();
+        n = scan->size();
+      } else if (packet.lidar_encoding() == TelemetryPacket::LIDAR_FLOAT32) {
+        ranges = packet.lidar_scan().data();
+        n = static_cast<size_t>(packet.lidar_scan_size());
+      }
+    }
+    if (full() || n > stride_)
+      return false;
+
+    const size_t i = size_++;
+    vehicle_[i] = intern(packet.vehicle_id());
+    timestamp_[i] = packet.timestamp();
+    capture_monotonic_[i] = packet.capture_monotonic();
+    wall_offset_[i] = packet.wall_offset();
+    channel_[i] = static_cast<uint8_t>(packet.channel());
+    const bool has_imu = packet.channel() != TelemetryPacket::CHANNEL_LIDAR;
+    accel_x_[i] = has_imu ? packet.imu_reading().accel_x() : 0.0f;
+    accel_y_[i] = has_imu ? packet.imu_reading().accel_y() : 0.0f;
+    accel_z_[i] = has_imu ? packet.imu_reading().accel_z() : 0.0f;
+    battery_[i] = has_imu ? packet.battery_level() : 0.0f;
+    lidar_points_[i] = static_cast<uint32_t>(n);
+    float *row = lidar_row(i);
+    if (n > 0)
+      std::memcpy(row, ranges, n * sizeof(float));
+    std::fill(row + n, row + stride_, INFINITY);
+    return true;
+  }
+
+  // Rebuilds frame i as a float32 packet. A float32 packet comes back
+  // serialized byte for byte as append() received it (BM_BatchToPacket
+  // checks this).
+  void to_packet(size_t i, TelemetryPacket *packet) const {
+    auto channel = static_cast<TelemetryPacket::SensorChannel>(channel_[i]);
+    packet->Clear();
+    packet->set_vehicle_id(vehicle_ids_[vehicle_[i]]);
+    packet->set_timestamp(timestamp_[i]);
+    packet->set_capture_monotonic(capture_monotonic_[i]);
+    packet->set_wall_offset(wall_offset_[i]);
+    packet->set_channel(channel);
+    if (channel != TelemetryPacket::CHANNEL_LIDAR) {
+      auto *imu = packet->mutable_imu_reading();
+      imu->set_accel_x(accel_x_[i]);
+      imu->set_accel_y(accel_y_[i]);
+      imu->set_accel_z(accel_z_[i]);
+      packet->set_battery_level(battery_[i]);
+    }
+    if (uint32_t n = lidar_points_[i]) {
+      auto *scan = packet->mutable_lidar_scan();
+      scan->Reserve(static_cast<int>(n));
+      std::memcpy(scan->AddNAlreadyReserved(static_cast<int>(n)),
+                  lidar_row(i), n * sizeof(float));
+    }
+  }
+
+  // Columns, size() entries each (capacity() allocated).
+  const int64_t *timestamps() const { return timestamp_.data(); }
+  const int64_t *capture_times() const { return capture_monotonic_.data(); }
+  const int64_t *wall_offsets() const { return wall_offset_.data(); }
+  const float *accel_x() const { return accel_x_.data(); }
+  const float *accel_y() const { return accel_y_.data(); }
+  const float *accel_z() const { return accel_z_.data(); }
+  const float *battery() const { return battery_.data(); }
+  const uint8_t *channels() const { return channel_.data(); }
+  const uint32_t *lidar_points() const { return lidar_points_.data(); }
+  const std::string &vehicle_id(size_t i) const {
+    return vehicle_ids_[vehicle_[i]];
+  }
+
+  float *lidar_row(size_t i) { return lidar_.data() + i * stride_; }
+  const float *lidar_row(size_t i) const {
+    return lidar_.data() + i * stride_;
+  }
+
+  // |accel| of every frame into out[0, size()).
+  void imu_magnitude(float *out) const {
+    const float *__restrict x = accel_x_.data();
+    const float *__restrict y = accel_y_.data();
+    const float *__restrict z = accel_z_.data();
+    for (size_t i = 0; i < size_; ++i)
+      out[i] = std::sqrt(x[i] * x[i] + y[i] * y[i] + z[i] * z[i]);
+  }
+
+  // Nearest return of every frame into out[0, size()); +inf without LiDAR.
+  void nearest_range(float *out) const {
+    constexpr size_t kAlign = AlignedArray<float>::kAlignment;
+    constexpr size_t kLanes = kRowAlignFloats;
+    for (size_t i = 0; i < size_; ++i) {
+      const float *row = static_cast<const float *>(
+          __builtin_assume_aligned(lidar_row(i), kAlign));
+      // One running minimum per lane over whole padded rows, written as a
+      // select so it maps onto minps without -ffast-math.
+      float lanes[kLanes];
+      std::fill(lanes, lanes + kLanes, INFINITY);
+      for (size_t j = 0; j < stride_; j += kLanes)
+        for (size_t k = 0; k < kLanes; ++k)
+          lanes[k] = row[j + k] < lanes[k] ? row[j + k] : lanes[k];
+      out[i] = *std::min_element(lanes, lanes + kLanes);
+    }
+  }
+
+private:
+  // Index of a vehicle id in this batch; batches usually hold few vehicles.
+  uint32_t intern(const std::string &id) {
+    for (size_t v = 0; v < vehicle_ids_.size(); ++v)
+      if (vehicle_ids_[v] == id)
+        return static_cast<uint32_t>(v);
+    vehicle_ids_.push_back(id);
+    return static_cast<uint32_t>(vehicle_ids_.size() - 1);
+  }
+
+  size_t capacity_ = 0;
+  size_t stride_ = 0;
+  size_t size_ = 0;
+  AlignedArray<int64_t> timestamp_, capture_monotonic_, wall_offset_;
+  AlignedArray<float> accel_x_, accel_y_, accel_z_, battery_;
+  AlignedArray<uint8_t> channel_;
+  AlignedArray<uint32_t> vehicle_;
+  AlignedArray<uint32_t> lidar_points_;
+  AlignedArray<float> lidar_;
+  std::vector<std::string> vehicle_ids_;
+};
+
+} // namespace omnistream
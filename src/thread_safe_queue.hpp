@@ -1,28 +1,50 @@
 #pragma once
 
+#include <algorithm>
+#include <chrono>
 #include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
 #include <mutex>
 #include <optional>
-#include <queue>
+
+#include "overflow_policy.hpp"
 
 namespace omnistream {
 
 // Thread-safe FIFO queue with blocking push/pop and graceful shutdown.
-// Uses mutex + condition variable (upgrade to lock-free for lower latency).
+// Uses mutex + condition variable; see SpscRingBuffer for the lock-free path.
+// A full queue blocks push() unless another OverflowPolicy is set; items
+// discarded by a policy are counted in dropped().
 template <typename T> class ThreadSafeQueue {
 public:
+  // Whether `incoming` supersedes the queued item `queued`.
+  using Coalescible = std::function<bool(const T &queued, const T &incoming)>;
+
   explicit ThreadSafeQueue(size_t capacity = 1000)
-      : capacity_(capacity), shutdown_(false) {}
+      : capacity_(std::max<size_t>(1, capacity)), shutdown_(false) {}
 
+  // Coalesce needs `coalescible` to tell which queued items a newer one
+  // supersedes.
+  // Call before the queue is shared.
+  void set_overflow(OverflowPolicy policy, Coalescible coalescible = {}) {
+    policy_ = policy;
+    coalescible_ = std::move(coalescible);
+  }
+
+  // Returns false only after shutdown; a dropped item still counts as pushed.
   bool push(T item) {
     std::unique_lock<std::mutex> lock(mutex_);
+    if (queue_.size() >= capacity_ && !shutdown_ && !make_room(item))
+      return true;
     not_full_.wait(lock,
                    [this] { return queue_.size() < capacity_ || shutdown_; });
 
     if (shutdown_)
       return false;
 
-    queue_.push(std::move(item));
+    queue_.push_back(std::move(item));
     lock.unlock();
     not_empty_.notify_one();
     return true;
@@ -35,11 +57,27 @@ public:
     if (shutdown_ && queue_.empty())
       return std::nullopt;
 
-    T item = std::move(queue_.front());
-    queue_.pop();
-    lock.unlock();
-    not_full_.notify_one();
-    return item;
+    return take(lock);
+  }
+
+  // Non-blocking pop; empty optional if nothing is queued.
+  std::optional<T> try_pop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (queue_.empty())
+      return std::nullopt;
+    return take(lock);
+  }
+
+  // Blocking pop bounded by timeout; empty optional on timeout or shutdown.
+  template <typename Rep, typename Period>
+  std::optional<T> pop_for(std::chrono::duration<Rep, Period> timeout) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!not_empty_.wait_for(lock, timeout,
+                             [this] { return !queue_.empty() || shutdown_; }))
+      return std::nullopt;
+    if (queue_.empty())
+      return std::nullopt;
+    return take(lock);
   }
 
   void shutdown() {
@@ -56,10 +94,69 @@ public:
     return queue_.size();
   }
 
+  size_t capacity() const { return capacity_; }
+  OverflowPolicy overflow() const { return policy_; }
+
+  uint64_t dropped() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return dropped_;
+  }
+
+  bool is_shutdown() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return shutdown_;
+  }
+
+  // True once shutdown() was called and every queued item has been popped.
+  bool closed() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return shutdown_ && queue_.empty();
+  }
+
 private:
-  std::queue<T> queue_;
+  // Applies the overflow policy to a full queue. Returns false if `item`
+  // itself is dropped; true if it should be queued (after waiting, for
+  // Block and for Coalesce when `item` supersedes nothing queued).
+  bool make_room(const T &item) {
+    switch (policy_) {
+    case OverflowPolicy::Block:
+      return true;
+    case OverflowPolicy::DropNewest:
+      dropped_++;
+      return false;
+    case OverflowPolicy::DropOldest:
+      queue_.pop_front();
+      dropped_++;
+      return true;
+    case OverflowPolicy::Coalesce: {
+      auto it = std::find_if(queue_.begin(), queue_.end(),
+                             [&](const T &queued) {
+                               return coalescible_(queued, item);
+                             });
+      if (it != queue_.end()) {
+        queue_.erase(it);
+        dropped_++;
+      }
+      return true;
+    }
+    }
+    return true;
+  }
+
+  T take(std::unique_lock<std::mutex> &lock) {
+    T item = std::move(queue_.front());
+    queue_.pop_front();
+    lock.unlock();
+    not_full_.notify_one();
+    return item;
+  }
+
+  std::deque<T> queue_;
   size_t capacity_;
   bool shutdown_;
+  OverflowPolicy policy_ = OverflowPolicy::Block;
+  Coalescible coalescible_;
+  uint64_t dropped_ = 0;
   mutable std::mutex mutex_;
   std::condition_variable not_empty_;
   std::condition_variable not_full_;
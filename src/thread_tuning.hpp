@@ -0,0 +1,233 @@
+#pragma once
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "logger.hpp"
+
+namespace omnistream {
+
+// Parses a CPU list such as "2,4-7"; returns false on malformed input.
+inline bool parse_cpu_list(const std::string &text, std::vector<int> *cpus) {
+  cpus->clear();
+  std::stringstream ss(text);
+  std::string item;
+  while (std::getline(ss, item, ',')) {
+    char *end = nullptr;
+    long first = std::strtol(item.c_str(), &end, 10);
+    long last = first;
+    if (end == item.c_str() || first < 0)
+      return false;
+    if (*end == '-') {
+      const char *rest = end + 1;
+      last = std::strtol(rest, &end, 10);
+      if (end == rest || last < first)
+        return false;
+    }
+    if (*end != '\0')
+      return false;
+    for (long cpu = first; cpu <= last; ++cpu)
+      cpus->push_back(static_cast<int>(cpu));
+  }
+  return !cpus->empty();
+}
+
+inline std::string format_cpu_list(const std::vector<int> &cpus) {
+  std::string out;
+  for (size_t i = 0; i < cpus.size(); ++i)
+    out += (i ? "," : "") + std::to_string(cpus[i]);
+  return out;
+}
+
+// Scheduling for one class of threads: fifo:PRIO (SCHED_FIFO, 1-99) or
+// nice:N (SCHED_OTHER with a per-thread nice value, -20..19).
+struct SchedSpec {
+  enum class Policy { Default, Fifo, Nice };
+  Policy policy = Policy::Default;
+  int value = 0;
+
+  bool parse(const std::string &text) {
+    auto colon = text.find(':');
+    if (colon == std::string::npos)
+      return false;
+    std::string kind = text.substr(0, colon);
+    char *end = nullptr;
+    long n = std::strtol(text.c_str() + colon + 1, &end, 10);
+    if (*end != '\0' || end == text.c_str() + colon + 1)
+      return false;
+    if (kind == "fifo" && n >= 1 && n <= 99)
+      policy = Policy::Fifo;
+    else if (kind == "nice" && n >= -20 && n <= 19)
+      policy = Policy::Nice;
+    else
+      return false;
+    value = static_cast<int>(n);
+    return true;
+  }
+
+  std::string name() const {
+    switch (policy) {
+    case Policy::Fifo:
+      return "fifo " + std::to_string(value);
+    case Policy::Nice:
+      return "nice " + std::to_string(value);
+    default:
+      return "default";
+    }
+  }
+};
+
+// Placement for one class of pipeline threads. Thread i of the class is
+// pinned to cpus[i % cpus.size()]; an empty list leaves it unpinned.
+struct ThreadRole {
+  std::vector<int> cpus;
+  SchedSpec sched;
+};
+
+// CPU affinity, scheduling class and memory locking for the agent's threads.
+//
+// Each pipeline thread calls apply() on itself as it starts, which also
+// registers it as one of ours. gRPC starts its own poller, executor and
+// timer threads lazily and offers no hook to place them, so pin_foreign()
+// instead sweeps /proc/self/task and moves every thread that never
+// registered onto the gRPC CPU set. Threads gRPC spawns later inherit the
+// mask of their parent, and the sweep can be repeated to catch stragglers.
+// Failures (typically EPERM without CAP_SYS_NICE) are reported, not fatal.
+class ThreadTuning {
+public:
+  ThreadRole physics;
+  ThreadRole network;
+  std::vector<int> grpc_cpus;
+  bool mlock = false;
+
+  bool enabled() const {
+    return !physics.cpus.empty() || !network.cpus.empty() ||
+           physics.sched.policy != SchedSpec::Policy::Default ||
+           network.sched.policy != SchedSpec::Policy::Default ||
+           !grpc_cpus.empty() || mlock;
+  }
+
+  // Locks current and future pages (mlockall). Call before the pools and
+  // queues are allocated.
+  bool lock_memory() {
+    if (!mlock)
+      return true;
+    if (::mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+      std::cerr << "[Threads] mlockall failed: " << std::strerror(errno)
+                << " (raise RLIMIT_MEMLOCK or run with CAP_IPC_LOCK)"
+                << std::endl;
+      return false;
+    }
+    std::cout << "[Threads] Memory locked" << std::endl;
+    return true;
+  }
+
+  // Names, pins and schedules the calling thread as `role_name`-`index`,
+  // and reports where it ended up.
+  void apply(const char *role_name, const ThreadRole &role, size_t index) {
+    std::string name = std::string(role_name) + "-" + std::to_string(index);
+    pthread_setname_np(pthread_self(), name.substr(0, 15).c_str());
+    pid_t tid = static_cast<pid_t>(::syscall(SYS_gettid));
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      ours_.insert(tid);
+    }
+    if (!enabled())
+      return;
+
+    std::string where = "cpu any";
+    if (!role.cpus.empty()) {
+      int cpu = role.cpus[index % role.cpus.size()];
+      std::vector<int> one{cpu};
+      where = set_affinity(0, one) ? "cpu " + std::to_string(cpu)
+                                   : "cpu any (pin to " +
+                                         std::to_string(cpu) + " failed)";
+    }
+    std::string sched = apply_sched(role.sched);
+
+    log_info("Threads") << name << " (tid " << tid << "): " << where << ", "
+                        << sched;
+  }
+
+  // Pins every thread of the process that did not call apply() to
+  // grpc_cpus. Only meaningful once all `expected` pipeline threads have
+  // registered; before that it does nothing. Returns the threads moved by
+  // this call.
+  size_t pin_foreign(size_t expected) {
+    if (grpc_cpus.empty())
+      return 0;
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (ours_.size() < expected)
+      return 0;
+    size_t moved = 0;
+    std::error_code ec;
+    for (const auto &entry :
+         std::filesystem::directory_iterator("/proc/self/task", ec)) {
+      pid_t tid = static_cast<pid_t>(
+          std::strtol(entry.path().filename().c_str(), nullptr, 10));
+      if (tid <= 0 || ours_.count(tid) || foreign_.count(tid))
+        continue;
+      if (set_affinity(tid, grpc_cpus))
+        moved++;
+      foreign_.insert(tid);
+    }
+    if (moved > 0)
+      log_info("Threads") << "Pinned " << moved << " gRPC/main threads to cpus "
+                          << format_cpu_list(grpc_cpus) << " ("
+                          << foreign_.size() << " total)";
+    return moved;
+  }
+
+private:
+  static bool set_affinity(pid_t tid, const std::vector<int> &cpus) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus)
+      if (cpu < CPU_SETSIZE)
+        CPU_SET(cpu, &set);
+    return ::sched_setaffinity(tid, sizeof(set), &set) == 0;
+  }
+
+  static std::string apply_sched(const SchedSpec &spec) {
+    switch (spec.policy) {
+    case SchedSpec::Policy::Fifo: {
+      sched_param param{};
+      param.sched_priority = spec.value;
+      int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+      return err == 0 ? spec.name()
+                      : "default (" + spec.name() +
+                            " failed: " + std::strerror(err) + ")";
+    }
+    case SchedSpec::Policy::Nice:
+      // Linux applies PRIO_PROCESS with a thread id to that thread only.
+      if (::setpriority(PRIO_PROCESS, static_cast<id_t>(::syscall(SYS_gettid)),
+                        spec.value) == 0)
+        return spec.name();
+      return "default (" + spec.name() + " failed: " + std::strerror(errno) +
+             ")";
+    default:
+      return "default";
+    }
+  }
+
+  std::mutex mutex_;
+  std::set<pid_t> ours_;
+  std::set<pid_t> foreign_;
+};
+
+} // namespace omnistream
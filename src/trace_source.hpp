@@ -0,0 +1,355 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "lidar_codec.hpp"
+#include "packet_pool.hpp"
+#include "sensor_source.hpp"
+#include "telemetry.pb.h"
+
+namespace omnistream {
+
+// On-disk layouts TraceFile understands.
+enum class TraceFormat {
+  Ranges, // One file of consecutive scans, each N native float32 ranges
+  Kitti,  // KITTI velodyne dump: one .bin per scan of float32 x, y, z, i
+};
+
+inline bool parse_trace_format(const std::string &name, TraceFormat *format) {
+  if (name == "ranges")
+    *format = TraceFormat::Ranges;
+  else if (name == "kitti")
+    *format = TraceFormat::Kitti;
+  else
+    return false;
+  return true;
+}
+
+// A recorded LiDAR (and optionally IMU) log, mapped read-only and shared by
+// every vehicle that plays it. Scans are read in place from the page cache:
+// nothing is copied or read() per frame, and prefetch() asks the kernel to
+// page in what the frame clock will need next.
+//
+// The IMU log, if any, is a flat file of float32 (accel_x, accel_y,
+// accel_z) triples in m/s^2, one per sample.
+class TraceFile {
+public:
+  // A KITTI scan is a sequence of (x, y, z, intensity) points.
+  static constexpr size_t kKittiFloats = 4;
+
+  struct Scan {
+    const float *data = nullptr;
+    size_t floats = 0;
+  };
+
+  TraceFile() = default;
+  TraceFile(const TraceFile &) = delete;
+  TraceFile &operator=(const TraceFile &) = delete;
+
+  // `path` is a ranges file, or for KITTI a directory of .bin scans (sorted
+  // by name) or a single one. `points` is the scan length of a ranges file.
+  bool open(const std::string &path, TraceFormat format, size_t points,
+            const std::string &imu_path = "") {
+    format_ = format;
+    points_ = points;
+    if (format == TraceFormat::Ranges) {
+      if (!map_file(path))
+        return false;
+      const size_t scan_bytes = points * sizeof(float);
+      if (maps_[0].size < scan_bytes)
+        return fail(path + " holds less than one " + std::to_string(points) +
+                    "-point scan");
+      scans_ = maps_[0].size / scan_bytes;
+    } else {
+      std::vector<std::string> files;
+      std::error_code ec;
+      if (std::filesystem::is_directory(path, ec)) {
+        for (const auto &entry : std::filesystem::directory_iterator(path, ec))
+          if (entry.path().extension() == ".bin")
+            files.push_back(entry.path().string());
+        std::sort(files.begin(), files.end());
+      } else {
+        files.push_back(path);
+      }
+      if (files.empty())
+        return fail("no .bin scans in " + path);
+      maps_.reserve(files.size());
+      for (const auto &file : files)
+        if (!map_file(file))
+          return false;
+      scans_ = maps_.size();
+    }
+    if (!imu_path.empty()) {
+      if (!map_file(imu_path, &imu_))
+        return false;
+      imu_samples_ = imu_.size / (3 * sizeof(float));
+    }
+    return true;
+  }
+
+  const std::string &error() const { return error_; }
+  TraceFormat format() const { return format_; }
+  size_t scans() const { return scans_; }
+  size_t points() const { return points_; } // Ranges format only
+  size_t imu_samples() const { return imu_samples_; }
+
+  Scan scan(size_t i) const {
+    i %= scans_;
+    if (format_ == TraceFormat::Ranges)
+      return {maps_[0].floats() + i * points_, points_};
+    const Mapping &m = maps_[i];
+    size_t floats = m.size / sizeof(float);
+    return {m.floats(), floats - floats % kKittiFloats};
+  }
+
+  // accel_x, accel_y, accel_z of IMU sample i, wrapping around.
+  const float *imu(size_t i) const {
+    return imu_.floats() + (i % imu_samples_) * 3;
+  }
+
+  // Starts paging in scans [first, first + count), wrapping around.
+  void prefetch(size_t first, size_t count) const {
+    count = std::min(count, scans_);
+    for (size_t n = 0; n < count; ++n) {
+      Scan s = scan(first + n);
+      will_need(s.data, s.floats * sizeof(float));
+    }
+  }
+
+private:
+  struct Mapping {
+    void *data = nullptr;
+    size_t size = 0;
+
+    Mapping() = default;
+    Mapping(const Mapping &) = delete;
+    Mapping &operator=(const Mapping &) = delete;
+    Mapping(Mapping &&o) noexcept { *this = std::move(o); }
+    Mapping &operator=(Mapping &&o) noexcept {
+      std::swap(data, o.data);
+      std::swap(size, o.size);
+      return *this;
+    }
+    ~Mapping() {
+      if (data)
+        ::munmap(data, size);
+    }
+
+    const float *floats() const { return static_cast<const float *>(data); }
+  };
+
+  bool map_file(const std::string &file, Mapping *out = nullptr) {
+    int fd = ::open(file.c_str(), O_RDONLY);
+    if (fd < 0)
+      return fail("cannot open " + file + ": " + std::strerror(errno));
+    struct stat st {};
+    void *p = MAP_FAILED;
+    if (::fstat(fd, &st) == 0 && st.st_size > 0)
+      p = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ,
+                 MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED)
+      return fail("cannot map " + file + " (empty or unreadable)");
+    // Playback is sequential; let the kernel read ahead aggressively.
+    ::madvise(p, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+    Mapping m;
+    m.data = p;
+    m.size = static_cast<size_t>(st.st_size);
+    if (out)
+      *out = std::move(m);
+    else
+      maps_.push_back(std::move(m));
+    return true;
+  }
+
+  static void will_need(const void *data, size_t bytes) {
+    static const uintptr_t page =
+        static_cast<uintptr_t>(::sysconf(_SC_PAGESIZE));
+    uintptr_t begin = reinterpret_cast<uintptr_t>(data) & ~(page - 1);
+    uintptr_t end = reinterpret_cast<uintptr_t>(data) + bytes;
+    ::madvise(reinterpret_cast<void *>(begin), end - begin, MADV_WILLNEED);
+  }
+
+  bool fail(const std::string &message) {
+    error_ = message;
+    return false;
+  }
+
+  TraceFormat format_ = TraceFormat::Ranges;
+  size_t points_ = 0;
+  size_t scans_ = 0;
+  std::vector<Mapping> maps_;
+  Mapping imu_;
+  size_t imu_samples_ = 0;
+  std::string error_;
+};
+
+// Plays a TraceFile as one vehicle, looping at the end. Each scan is
+// resampled straight into the packet's repeated field at lidar_points():
+// a ranges trace keeps the nearest return per output bin, and a KITTI point
+// cloud is flattened to the closest return above the ground per azimuth
+// bin (point i of n at i * 360 / n degrees, as in the synthetic scans).
+// Without an IMU log the IMU reports gravity only.
+class TraceSource : public SensorSource {
+public:
+  // Scans paged in ahead of the one being sent.
+  static constexpr size_t kPrefetchScans = 16;
+  // KITTI's Velodyne sits 1.73 m up; lower points are treated as ground.
+  static constexpr float kKittiMinZ = -1.4f;
+  // Range reported for an azimuth bin with no return.
+  static constexpr float kKittiMaxRange = 120.0f;
+
+  // `start` offsets this vehicle into the trace so that vehicles sharing
+  // one trace do not send identical scans.
+  TraceSource(const std::string &vehicle_id,
+              std::shared_ptr<const TraceFile> trace, size_t lidar_points,
+              size_t start = 0, PacketPool *pool = nullptr)
+      : vehicle_id_(vehicle_id), trace_(std::move(trace)),
+        lidar_points_(lidar_points), start_(start % trace_->scans()),
+        pool_(pool) {
+    trace_->prefetch(start_, kPrefetchScans);
+  }
+
+  PacketPtr generate() override {
+    auto packet = start_packet(TelemetryPacket::CHANNEL_COMBINED);
+    fill_lidar(packet.get());
+    fill_imu(packet.get());
+    return packet;
+  }
+
+  PacketPtr generate_imu() override {
+    auto packet = start_packet(TelemetryPacket::CHANNEL_IMU);
+    fill_imu(packet.get());
+    return packet;
+  }
+
+  PacketPtr generate_lidar() override {
+    auto packet = start_packet(TelemetryPacket::CHANNEL_LIDAR);
+    fill_lidar(packet.get());
+    return packet;
+  }
+
+  // Samples are played back one per packet; the rates only pace the
+  // battery model.
+  void set_rates(double imu_hz, double /*lidar_hz*/) override {
+    imu_scale_ = 60.0 / imu_hz;
+  }
+
+  void set_lidar_encoder(const LidarDeltaEncoder &encoder) override {
+    lidar_encoder_ = encoder;
+  }
+
+  void set_lidar_points(size_t points) override { lidar_points_ = points; }
+
+  uint64_t tick() const override { return tick_; }
+  size_t lidar_points() const override { return lidar_points_; }
+  const char *lidar_source() const override {
+    return trace_->format() == TraceFormat::Kitti ? "kitti trace"
+                                                  : "ranges trace";
+  }
+
+private:
+  PacketPtr start_packet(TelemetryPacket::SensorChannel channel) {
+    auto packet = pool_ ? pool_->acquire() : PacketPtr(new TelemetryPacket());
+    packet->set_vehicle_id(vehicle_id_);
+    stamp_capture_time(packet.get());
+    packet->set_channel(channel);
+    return packet;
+  }
+
+  void fill_lidar(TelemetryPacket *pkt) {
+    const size_t index = start_ + tick_++;
+    // Top up the prefetch window every half window.
+    if (tick_ % (kPrefetchScans / 2) == 0)
+      trace_->prefetch(index + kPrefetchScans / 2, kPrefetchScans);
+
+    TraceFile::Scan src = trace_->scan(index);
+    int points = static_cast<int>(lidar_points_);
+    auto *scan = pkt->mutable_lidar_scan();
+    scan->Clear();
+    scan->Reserve(points);
+    float *out = scan->AddNAlreadyReserved(points);
+    if (trace_->format() == TraceFormat::Kitti)
+      flatten_cloud(src, out, lidar_points_);
+    else
+      resample(src, out, lidar_points_);
+    if (lidar_encoder_)
+      lidar_encoder_->encode(pkt);
+  }
+
+  static void resample(const TraceFile::Scan &src, float *out, size_t n) {
+    const size_t m = src.floats;
+    if (n == m) {
+      std::memcpy(out, src.data, m * sizeof(float));
+      return;
+    }
+    for (size_t i = 0; i < n; ++i) {
+      size_t lo = i * m / n;
+      size_t hi = std::max(lo + 1, (i + 1) * m / n);
+      out[i] = *std::min_element(src.data + lo, src.data + hi);
+    }
+  }
+
+  static void flatten_cloud(const TraceFile::Scan &src, float *out, size_t n) {
+    constexpr float kTwoPi = 6.28318530718f;
+    std::fill(out, out + n, kKittiMaxRange);
+    const float bins_per_rad = static_cast<float>(n) / kTwoPi;
+    for (size_t p = 0; p < src.floats; p += TraceFile::kKittiFloats) {
+      float x = src.data[p], y = src.data[p + 1], z = src.data[p + 2];
+      if (z < kKittiMinZ)
+        continue;
+      float azimuth = std::atan2(y, x);
+      if (azimuth < 0.0f)
+        azimuth += kTwoPi;
+      size_t bin = std::min(n - 1, static_cast<size_t>(azimuth * bins_per_rad));
+      out[bin] = std::min(out[bin], std::sqrt(x * x + y * y));
+    }
+  }
+
+  void fill_imu(TelemetryPacket *pkt) {
+    auto *imu = pkt->mutable_imu_reading();
+    if (trace_->imu_samples() > 0) {
+      const float *a = trace_->imu(start_ + imu_tick_);
+      imu->set_accel_x(a[0]);
+      imu->set_accel_y(a[1]);
+      imu->set_accel_z(a[2]);
+    } else {
+      imu->set_accel_x(0.0f);
+      imu->set_accel_y(0.0f);
+      imu->set_accel_z(9.81f);
+    }
+    imu_tick_++;
+    battery_ = std::max(0.0f, battery_ - 0.0001f * static_cast<float>(
+                                              imu_scale_));
+    pkt->set_battery_level(battery_);
+  }
+
+  std::string vehicle_id_;
+  std::shared_ptr<const TraceFile> trace_;
+  size_t lidar_points_;
+  size_t start_;
+  uint64_t tick_ = 0; // LiDAR scans sent
+  uint64_t imu_tick_ = 0;
+  double imu_scale_ = 1.0;
+  float battery_ = 100.0f;
+  PacketPool *pool_;
+  std::optional<LidarDeltaEncoder> lidar_encoder_;
+};
+
+} // namespace omnistream
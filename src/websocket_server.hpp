@@ -0,0 +1,518 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace omnistream {
+
+namespace ws {
+
+// SHA-1 of the handshake key (RFC 6455 section 4.2.2). Only used for the
+// Sec-WebSocket-Accept header, never for anything security relevant.
+inline std::string sha1(std::string_view in) {
+  uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476,
+                   0xC3D2E1F0};
+  std::string msg(in);
+  uint64_t bits = static_cast<uint64_t>(msg.size()) * 8;
+  msg.push_back(static_cast<char>(0x80));
+  while (msg.size() % 64 != 56)
+    msg.push_back('\0');
+  for (int i = 7; i >= 0; --i)
+    msg.push_back(static_cast<char>(bits >> (i * 8)));
+
+  auto rol = [](uint32_t v, int n) { return (v << n) | (v >> (32 - n)); };
+  for (size_t block = 0; block < msg.size(); block += 64) {
+    uint32_t w[80];
+    for (int i = 0; i < 16; ++i) {
+      const auto *p =
+          reinterpret_cast<const uint8_t *>(msg.data() + block + i * 4);
+      w[i] = uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 |
+             uint32_t(p[2]) << 8 | p[3];
+    }
+    for (int i = 16; i < 80; ++i)
+      w[i] = rol(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+    for (int i = 0; i < 80; ++i) {
+      uint32_t f, k;
+      if (i < 20) {
+        f = (b & c) | (~b & d);
+        k = 0x5A827999;
+      } else if (i < 40) {
+        f = b ^ c ^ d;
+        k = 0x6ED9EBA1;
+      } else if (i < 60) {
+        f = (b & c) | (b & d) | (c & d);
+        k = 0x8F1BBCDC;
+      } else {
+        f = b ^ c ^ d;
+        k = 0xCA62C1D6;
+      }
+      uint32_t t = rol(a, 5) + f + e + k + w[i];
+      e = d;
+      d = c;
+      c = rol(b, 30);
+      b = a;
+      a = t;
+    }
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+  }
+
+  std::string digest(20, '\0');
+  for (int i = 0; i < 20; ++i)
+    digest[i] = static_cast<char>(h[i / 4] >> (24 - (i % 4) * 8));
+  return digest;
+}
+
+inline std::string base64(std::string_view in) {
+  static const char table[] =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  std::string out;
+  for (size_t i = 0; i < in.size(); i += 3) {
+    uint32_t n = uint8_t(in[i]) << 16;
+    if (i + 1 < in.size())
+      n |= uint8_t(in[i + 1]) << 8;
+    if (i + 2 < in.size())
+      n |= uint8_t(in[i + 2]);
+    out.push_back(table[(n >> 18) & 63]);
+    out.push_back(table[(n >> 12) & 63]);
+    out.push_back(i + 1 < in.size() ? table[(n >> 6) & 63] : '=');
+    out.push_back(i + 2 < in.size() ? table[n & 63] : '=');
+  }
+  return out;
+}
+
+enum Opcode : uint8_t {
+  kText = 0x1,
+  kBinary = 0x2,
+  kClose = 0x8,
+  kPing = 0x9,
+  kPong = 0xA,
+};
+
+// An unmasked, unfragmented server frame.
+inline std::string frame(uint8_t opcode, std::string_view payload) {
+  std::string out;
+  out.reserve(payload.size() + 10);
+  out.push_back(static_cast<char>(0x80 | opcode));
+  if (payload.size() < 126) {
+    out.push_back(static_cast<char>(payload.size()));
+  } else if (payload.size() <= 0xFFFF) {
+    out.push_back(126);
+    out.push_back(static_cast<char>(payload.size() >> 8));
+    out.push_back(static_cast<char>(payload.size()));
+  } else {
+    out.push_back(127);
+    for (int i = 7; i >= 0; --i)
+      out.push_back(static_cast<char>(uint64_t(payload.size()) >> (i * 8)));
+  }
+  out.append(payload);
+  return out;
+}
+
+} // namespace ws
+
+// Minimal WebSocket server for the dashboard: one poll() thread owns every
+// socket, so no client state is shared. A frame is encoded once and the same
+// buffer is queued for every recipient. Each client has a bounded backlog;
+// frames that would exceed it are dropped for that client only, so a stalled
+// browser never slows the others or grows memory without bound. Text
+// messages from clients go to Handlers::on_message; other data is ignored.
+class WebSocketServer {
+public:
+  using Frame = std::shared_ptr<const std::string>;
+  using ClientId = uint64_t;
+
+  // Called on the I/O thread. on_open returns the text message sent right
+  // after the handshake (empty for none).
+  struct Handlers {
+    std::function<std::string(ClientId)> on_open;
+    std::function<void(ClientId, std::string_view)> on_message;
+    std::function<void(ClientId)> on_close;
+  };
+
+  static constexpr size_t kMaxRequestBytes = 8 << 10;
+
+  explicit WebSocketServer(uint16_t port, size_t max_backlog_bytes = 4 << 20)
+      : port_(port), max_backlog_(max_backlog_bytes) {}
+
+  ~WebSocketServer() { stop(); }
+
+  WebSocketServer(const WebSocketServer &) = delete;
+  WebSocketServer &operator=(const WebSocketServer &) = delete;
+
+  // Set before start().
+  void set_handlers(Handlers handlers) { handlers_ = std::move(handlers); }
+
+  static Frame make_frame(uint8_t opcode, std::string_view payload) {
+    return std::make_shared<const std::string>(ws::frame(opcode, payload));
+  }
+
+  bool start() {
+    listen_fd_ = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    int one = 1;
+    ::setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port_);
+    if (listen_fd_ < 0 ||
+        ::bind(listen_fd_, reinterpret_cast<sockaddr *>(&addr),
+               sizeof(addr)) != 0 ||
+        ::listen(listen_fd_, 64) != 0) {
+      std::cerr << "[WS] Cannot listen on port " << port_ << ": "
+                << std::strerror(errno) << std::endl;
+      return false;
+    }
+    wake_fd_ = ::eventfd(0, EFD_NONBLOCK);
+    running_ = true;
+    thread_ = std::thread([this] { run(); });
+    std::cout << "[WS] Listening on ws://0.0.0.0:" << port_ << std::endl;
+    return true;
+  }
+
+  void stop() {
+    if (!running_.exchange(false))
+      return;
+    wake();
+    thread_.join();
+    for (auto &client : clients_)
+      ::close(client.fd);
+    clients_.clear();
+    ::close(listen_fd_);
+    ::close(wake_fd_);
+  }
+
+  // Queues a text message for every connected client. Thread-safe.
+  void broadcast(std::string_view text) {
+    post({make_frame(ws::kText, text), {}, true});
+  }
+
+  // Queues a frame for the given clients; unknown ids are skipped.
+  // Thread-safe.
+  void send(std::vector<ClientId> to, Frame frame) {
+    post({std::move(frame), std::move(to), false});
+  }
+
+  size_t clients() const { return client_count_; }
+  uint64_t dropped() const { return dropped_; }
+
+private:
+  struct Delivery {
+    Frame frame;
+    std::vector<ClientId> to;
+    bool all;
+  };
+
+  struct Client {
+    ClientId id = 0;
+    int fd = -1;
+    bool open = false;     // Handshake done
+    bool closing = false;  // Close once the backlog is flushed
+    std::string in;        // Unparsed request or frame bytes
+    std::deque<Frame> out; // Front is partially sent up to `offset`
+    size_t offset = 0;
+    size_t backlog = 0;    // Unsent bytes
+  };
+
+  void post(Delivery delivery) {
+    {
+      std::lock_guard<std::mutex> lock(outbox_mutex_);
+      outbox_.push_back(std::move(delivery));
+    }
+    wake();
+  }
+
+  void wake() {
+    uint64_t one = 1;
+    [[maybe_unused]] ssize_t n = ::write(wake_fd_, &one, sizeof(one));
+  }
+
+  void run() {
+    std::vector<pollfd> fds;
+    std::vector<Delivery> pending;
+    std::unordered_map<ClientId, Client *> by_id;
+    while (running_) {
+      fds.clear();
+      fds.push_back({wake_fd_, POLLIN, 0});
+      fds.push_back({listen_fd_, POLLIN, 0});
+      for (const auto &client : clients_)
+        fds.push_back(
+            {client.fd, short(POLLIN | (client.out.empty() ? 0 : POLLOUT)),
+             0});
+      if (::poll(fds.data(), fds.size(), 100) < 0 && errno != EINTR)
+        break;
+
+      if (fds[0].revents & POLLIN) {
+        uint64_t n;
+        [[maybe_unused]] ssize_t r = ::read(wake_fd_, &n, sizeof(n));
+        {
+          std::lock_guard<std::mutex> lock(outbox_mutex_);
+          pending.swap(outbox_);
+        }
+        by_id.clear();
+        for (auto &client : clients_)
+          if (client.open && !client.closing)
+            by_id[client.id] = &client;
+        for (const auto &delivery : pending) {
+          if (delivery.all) {
+            for (auto &[id, client] : by_id)
+              enqueue(*client, delivery.frame);
+            continue;
+          }
+          for (ClientId id : delivery.to) {
+            auto it = by_id.find(id);
+            if (it != by_id.end())
+              enqueue(*it->second, delivery.frame);
+          }
+        }
+        pending.clear();
+      }
+      if (fds[1].revents & POLLIN)
+        accept_clients();
+
+      // Clients accepted above have no pollfd yet; they are polled next pass.
+      for (size_t i = 2; i < fds.size(); ++i) {
+        Client &client = clients_[i - 2];
+        if (fds[i].revents & (POLLERR | POLLHUP | POLLNVAL))
+          drop(client);
+        if (fds[i].revents & POLLIN)
+          read_client(client);
+        if (!client.out.empty())
+          flush(client);
+      }
+
+      size_t before = clients_.size();
+      clients_.erase(std::remove_if(clients_.begin(), clients_.end(),
+                                    [this](const Client &c) {
+                                      if (!c.closing || !c.out.empty())
+                                        return false;
+                                      ::close(c.fd);
+                                      if (c.open && handlers_.on_close)
+                                        handlers_.on_close(c.id);
+                                      return true;
+                                    }),
+                     clients_.end());
+      if (clients_.size() != before)
+        log_clients("disconnected");
+    }
+  }
+
+  void accept_clients() {
+    while (true) {
+      int fd = ::accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK);
+      if (fd < 0)
+        return;
+      int one = 1;
+      ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+      clients_.emplace_back();
+      clients_.back().id = next_id_++;
+      clients_.back().fd = fd;
+    }
+  }
+
+  // The peer is gone: discard the backlog so the client is removed.
+  static void drop(Client &client) {
+    client.closing = true;
+    client.out.clear();
+    client.backlog = 0;
+  }
+
+  void enqueue(Client &client, const Frame &frame) {
+    if (client.backlog + frame->size() > max_backlog_) {
+      dropped_++;
+      return;
+    }
+    client.backlog += frame->size();
+    client.out.push_back(frame);
+  }
+
+  void flush(Client &client) {
+    while (!client.out.empty()) {
+      const std::string &frame = *client.out.front();
+      ssize_t n = ::send(client.fd, frame.data() + client.offset,
+                         frame.size() - client.offset, MSG_NOSIGNAL);
+      if (n < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
+          drop(client);
+        return;
+      }
+      client.offset += n;
+      client.backlog -= n;
+      if (client.offset < frame.size())
+        return;
+      client.out.pop_front();
+      client.offset = 0;
+    }
+  }
+
+  void read_client(Client &client) {
+    char buf[4096];
+    while (true) {
+      ssize_t n = ::recv(client.fd, buf, sizeof(buf), 0);
+      if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+        drop(client);
+        return;
+      }
+      if (n < 0)
+        break;
+      client.in.append(buf, n);
+    }
+    if (!client.open)
+      handshake(client);
+    if (client.open)
+      parse_frames(client);
+  }
+
+  void handshake(Client &client) {
+    auto end = client.in.find("\r\n\r\n");
+    if (end == std::string::npos) {
+      if (client.in.size() > kMaxRequestBytes)
+        client.closing = true;
+      return;
+    }
+    std::string key = header(client.in.substr(0, end), "sec-websocket-key");
+    if (key.empty()) {
+      reply(client, "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\n"
+                    "Connection: close\r\n\r\n");
+      client.closing = true;
+      return;
+    }
+    client.in.erase(0, end + 4);
+    std::string accept =
+        ws::base64(ws::sha1(key + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"));
+    reply(client, "HTTP/1.1 101 Switching Protocols\r\n"
+                  "Upgrade: websocket\r\nConnection: Upgrade\r\n"
+                  "Sec-WebSocket-Accept: " +
+                      accept + "\r\n\r\n");
+    client.open = true;
+    if (handlers_.on_open) {
+      std::string greeting = handlers_.on_open(client.id);
+      if (!greeting.empty())
+        reply(client, ws::frame(ws::kText, greeting));
+    }
+    log_clients("connected");
+  }
+
+  // Handles complete client frames: control frames are answered, text goes
+  // to on_message and binary is discarded. Fragmented messages are not
+  // expected from the dashboard and are dropped.
+  void parse_frames(Client &client) {
+    std::string &in = client.in;
+    while (in.size() >= 2) {
+      auto *p = reinterpret_cast<const uint8_t *>(in.data());
+      bool fin = p[0] & 0x80;
+      uint8_t opcode = p[0] & 0x0F;
+      bool masked = p[1] & 0x80;
+      if (!masked) {
+        // RFC 6455 5.1: every client frame is masked; fail with 1002.
+        reply(client, ws::frame(ws::kClose, std::string("\x03\xea", 2)));
+        client.closing = true;
+        return;
+      }
+      uint64_t len = p[1] & 0x7F;
+      size_t pos = 2;
+      if (len == 126 || len == 127) {
+        size_t bytes = len == 126 ? 2 : 8;
+        if (in.size() < pos + bytes)
+          return;
+        len = 0;
+        for (size_t i = 0; i < bytes; ++i)
+          len = len << 8 | p[pos + i];
+        pos += bytes;
+      }
+      if (len > kMaxRequestBytes) {
+        client.closing = true;
+        return;
+      }
+      size_t mask_at = pos;
+      pos += 4;
+      if (in.size() < pos + len)
+        return;
+
+      std::string payload = in.substr(pos, len);
+      for (size_t i = 0; i < payload.size(); ++i)
+        payload[i] ^= p[mask_at + i % 4];
+      in.erase(0, pos + len);
+
+      if (opcode == ws::kClose) {
+        reply(client, ws::frame(ws::kClose, payload.substr(0, 2)));
+        client.closing = true;
+        return;
+      }
+      if (opcode == ws::kPing)
+        reply(client, ws::frame(ws::kPong, payload));
+      else if (opcode == ws::kText && fin && handlers_.on_message)
+        handlers_.on_message(client.id, payload);
+    }
+  }
+
+  // Control replies bypass the backlog limit so they are never dropped.
+  void reply(Client &client, std::string bytes) {
+    client.backlog += bytes.size();
+    client.out.push_back(std::make_shared<const std::string>(std::move(bytes)));
+  }
+
+  static std::string header(const std::string &request, const char *name) {
+    std::string lower(request);
+    std::transform(lower.begin(), lower.end(), lower.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+    std::string needle = std::string("\r\n") + name + ":";
+    auto at = lower.find(needle);
+    if (at == std::string::npos)
+      return {};
+    auto begin = request.find_first_not_of(' ', at + needle.size());
+    auto end = request.find("\r\n", begin);
+    return request.substr(begin, end - begin);
+  }
+
+  void log_clients(const char *event) {
+    client_count_ = std::count_if(clients_.begin(), clients_.end(),
+                                  [](const Client &c) { return c.open; });
+    std::cout << "[WS] Client " << event << " (" << client_count_
+              << " total)" << std::endl;
+  }
+
+  uint16_t port_;
+  size_t max_backlog_;
+  Handlers handlers_;
+  ClientId next_id_ = 1;
+  int listen_fd_ = -1;
+  int wake_fd_ = -1;
+  std::atomic<bool> running_{false};
+  std::thread thread_;
+  std::vector<Client> clients_; // Owned by the I/O thread
+  std::mutex outbox_mutex_;
+  std::vector<Delivery> outbox_;
+  std::atomic<size_t> client_count_{0};
+  std::atomic<uint64_t> dropped_{0};
+};
+
+} // namespace omnistream
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "packet_pool.hpp"
+#include "telemetry.grpc.pb.h"
+#include "telemetry.pb.h"
+#include <grpcpp/grpcpp.h>
+#include <grpcpp/impl/codegen/proto_utils.h>
+
+namespace omnistream {
+
+// Serializes a pooled packet into its slot's wire buffer on the producer
+// thread, so the network thread only hands bytes to gRPC. The string keeps
+// its capacity across pool reuse. Returns false for packets made outside a
+// pool, which are serialized on the network thread as before.
+inline bool pre_serialize(const PacketPtr &packet) {
+  std::string *wire = PacketPool::wire(packet);
+  return wire && packet->SerializeToString(wire);
+}
+
+// Request payload for a raw stream. A pre-serialized packet is wrapped in a
+// slice that points at its wire buffer, and the packet is returned to the
+// pool only when gRPC releases the slice, so the bytes are never copied.
+// Other packets are serialized here.
+inline grpc::ByteBuffer to_byte_buffer(PacketPtr packet) {
+  grpc::ByteBuffer buffer;
+  std::string *wire = PacketPool::wire(packet);
+  if (wire && !wire->empty()) {
+    grpc::Slice slice(wire->data(), wire->size(),
+                      [](void *p) {
+                        auto *slot = static_cast<PacketPool::Slot *>(p);
+                        PacketPtr(&slot->packet, PacketPool::Recycler{slot});
+                      },
+                      packet.get_deleter().slot);
+    packet.release();
+    grpc::ByteBuffer(&slice, 1).Swap(&buffer);
+  } else {
+    bool own = false;
+    grpc::SerializationTraits<TelemetryPacket>::Serialize(*packet, &buffer,
+                                                          &own);
+  }
+  return buffer;
+}
+
+// TelemetryStream.StreamTelemetry with ByteBuffer requests, so already
+// serialized packets are sent as-is. Built the same way as the generated stub;
+// the server sees an ordinary TelemetryPacket stream.
+class RawTelemetryStub {
+public:
+  using Writer = grpc::ClientReaderWriter<grpc::ByteBuffer, ServerAck>;
+  using AsyncWriter =
+      grpc::ClientAsyncReaderWriter<grpc::ByteBuffer, ServerAck>;
+
+  explicit RawTelemetryStub(std::shared_ptr<grpc::ChannelInterface> channel)
+      : channel_(channel),
+        method_("/omnistream.TelemetryStream/StreamTelemetry",
+                grpc::internal::RpcMethod::BIDI_STREAMING, channel) {}
+
+  std::unique_ptr<Writer> StreamTelemetry(grpc::ClientContext *ctx) {
+    return std::unique_ptr<Writer>(
+        grpc::internal::ClientReaderWriterFactory<
+            grpc::ByteBuffer, ServerAck>::Create(channel_.get(), method_, ctx));
+  }
+
+  std::unique_ptr<AsyncWriter>
+  PrepareAsyncStreamTelemetry(grpc::ClientContext *ctx,
+                              grpc::CompletionQueue *cq) {
+    return std::unique_ptr<AsyncWriter>(
+        grpc::internal::ClientAsyncReaderWriterFactory<
+            grpc::ByteBuffer, ServerAck>::Create(channel_.get(), cq, method_,
+                                                 ctx, false, nullptr));
+  }
+
+private:
+  std::shared_ptr<grpc::ChannelInterface> channel_;
+  const grpc::internal::RpcMethod method_;
+};
+
+} // namespace omnistream